@@ -0,0 +1,304 @@
+// Runs every program of the benchmark corpus through the onol binary N
+// times and reports wall time, hardware counters and peak RSS as JSON.
+//
+//   corpus-runner [-n runs] [-o out.json] [-a interpreter-arg]...
+//                 [--generated bytes] onol corpus-dir-or-file...
+//
+// Counters come from perf_event_open and are reported as null where the
+// kernel does not allow them (e.g. perf_event_paranoid or a container).
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#include "generated_source.hpp"
+
+namespace fs = std::filesystem;
+
+enum Counter { INSTRUCTIONS, CYCLES, BRANCH_MISSES, COUNTER_COUNT };
+
+static constexpr const char* COUNTER_NAMES[] = {"instructions", "cycles",
+                                                "branch_misses"};
+
+struct Sample {
+  double wallMs = 0;
+  std::optional<uint64_t> counters[COUNTER_COUNT];
+  long peakRssKb = 0;
+};
+
+struct Program {
+  std::string name;
+  fs::path path;
+  std::vector<Sample> samples;
+};
+
+struct Options {
+  int runs = 10;
+  std::string output = "corpus.json";
+  std::vector<std::string> interpreterArgs;
+  std::size_t generatedBytes = 4 << 20;
+  std::string interpreter;
+  std::vector<fs::path> inputs;
+};
+
+#ifdef __linux__
+static int openCounter(Counter counter, pid_t pid) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = counter == INSTRUCTIONS ? PERF_COUNT_HW_INSTRUCTIONS
+                : counter == CYCLES     ? PERF_COUNT_HW_CPU_CYCLES
+                                        : PERF_COUNT_HW_BRANCH_MISSES;
+  attr.disabled = 1;
+  attr.enable_on_exec = 1;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return static_cast<int>(
+      syscall(SYS_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC));
+}
+#endif
+
+// Forks the interpreter stopped on a pipe, attaches the counters, then lets
+// it exec so counting covers exactly the interpreter process.
+static std::optional<Sample> runOnce(const Options& options,
+                                     const fs::path& program) {
+  int gate[2];
+  if (pipe(gate) != 0) return std::nullopt;
+
+  pid_t pid = fork();
+  if (pid < 0) return std::nullopt;
+
+  if (pid == 0) {
+    close(gate[1]);
+    char go;
+    if (read(gate[0], &go, 1) != 1) _exit(127);
+    close(gate[0]);
+
+    int devNull = open("/dev/null", O_WRONLY);
+    if (devNull >= 0) dup2(devNull, STDOUT_FILENO);
+
+    std::vector<std::string> args = {options.interpreter};
+    args.insert(args.end(), options.interpreterArgs.begin(),
+                options.interpreterArgs.end());
+    args.push_back(program.string());
+
+    std::vector<char*> argv;
+    for (std::string& arg : args) argv.push_back(arg.data());
+    argv.push_back(nullptr);
+    execvp(argv[0], argv.data());
+    _exit(127);
+  }
+
+  close(gate[0]);
+  int fds[COUNTER_COUNT] = {-1, -1, -1};
+#ifdef __linux__
+  for (int c = 0; c < COUNTER_COUNT; c++) {
+    fds[c] = openCounter(static_cast<Counter>(c), pid);
+  }
+#endif
+
+  auto start = std::chrono::steady_clock::now();
+  ssize_t released = write(gate[1], "g", 1);
+  close(gate[1]);
+
+  int status = 0;
+  rusage usage;
+  pid_t waited = wait4(pid, &status, 0, &usage);
+  auto end = std::chrono::steady_clock::now();
+
+  Sample sample;
+  sample.wallMs =
+      std::chrono::duration<double, std::milli>(end - start).count();
+  sample.peakRssKb = usage.ru_maxrss;
+  for (int c = 0; c < COUNTER_COUNT; c++) {
+    uint64_t value;
+    if (fds[c] >= 0 && read(fds[c], &value, sizeof(value)) == sizeof(value)) {
+      sample.counters[c] = value;
+    }
+    if (fds[c] >= 0) close(fds[c]);
+  }
+
+  if (released != 1 || waited != pid || !WIFEXITED(status) ||
+      WEXITSTATUS(status) != 0) {
+    std::cerr << program.string() << " failed (status " << status << ").\n";
+    return std::nullopt;
+  }
+  return sample;
+}
+
+template <typename T>
+static void writeStats(std::ostream& out, std::vector<T> values) {
+  if (values.empty()) {
+    out << "null";
+    return;
+  }
+  std::sort(values.begin(), values.end());
+  double mean = 0;
+  for (T value : values) mean += static_cast<double>(value);
+  mean /= values.size();
+
+  out << "{\"min\": " << values.front()
+      << ", \"median\": " << values[values.size() / 2]
+      << ", \"mean\": " << mean << ", \"max\": " << values.back() << "}";
+}
+
+static std::string escape(const std::string& text) {
+  std::string escaped;
+  for (char c : text) {
+    if (c == '"' || c == '\\') escaped += '\\';
+    escaped += c;
+  }
+  return escaped;
+}
+
+static void writeJson(std::ostream& out, const Options& options,
+                      const std::vector<Program>& programs) {
+  out << std::setprecision(6) << std::fixed;
+  out << "{\n  \"interpreter\": \"" << escape(options.interpreter) << "\",\n"
+      << "  \"args\": [";
+  for (std::size_t i = 0; i < options.interpreterArgs.size(); i++) {
+    out << (i ? ", " : "") << "\"" << escape(options.interpreterArgs[i])
+        << "\"";
+  }
+  out << "],\n  \"runs\": " << options.runs << ",\n  \"programs\": [\n";
+
+  for (std::size_t p = 0; p < programs.size(); p++) {
+    const Program& program = programs[p];
+    out << "    {\n      \"name\": \"" << escape(program.name) << "\",\n"
+        << "      \"bytes\": " << fs::file_size(program.path) << ",\n"
+        << "      \"wall_ms\": ";
+
+    std::vector<double> wall;
+    std::vector<long> rss;
+    for (const Sample& sample : program.samples) {
+      wall.push_back(sample.wallMs);
+      rss.push_back(sample.peakRssKb);
+    }
+    writeStats(out, wall);
+
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+      std::vector<uint64_t> values;
+      for (const Sample& sample : program.samples) {
+        if (sample.counters[c]) values.push_back(*sample.counters[c]);
+      }
+      out << ",\n      \"" << COUNTER_NAMES[c] << "\": ";
+      // Partial counts would not be comparable with other results.
+      if (values.size() != program.samples.size()) values.clear();
+      writeStats(out, values);
+    }
+
+    out << ",\n      \"peak_rss_kb\": ";
+    writeStats(out, rss);
+    out << "\n    }" << (p + 1 < programs.size() ? "," : "") << "\n";
+  }
+  out << "  ]\n}\n";
+}
+
+static void usage() {
+  std::cerr << "Usage: corpus-runner [-n runs] [-o out.json] "
+               "[-a interpreter-arg]...\n"
+               "                     [--generated bytes] onol "
+               "corpus-dir-or-file...\n";
+  exit(64);
+}
+
+static Options parseOptions(int argc, const char* argv[]) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-n" && hasValue) {
+      options.runs = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "-o" && hasValue) {
+      options.output = argv[++i];
+    } else if (arg == "-a" && hasValue) {
+      options.interpreterArgs.push_back(argv[++i]);
+    } else if (arg == "--generated" && hasValue) {
+      options.generatedBytes = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg.starts_with("-")) {
+      usage();
+    } else if (options.interpreter.empty()) {
+      options.interpreter = arg;
+    } else {
+      options.inputs.push_back(arg);
+    }
+  }
+  if (options.interpreter.empty() || options.inputs.empty()) usage();
+  return options;
+}
+
+static std::vector<Program> collectPrograms(const Options& options) {
+  std::vector<Program> programs;
+  for (const fs::path& input : options.inputs) {
+    std::vector<fs::path> files;
+    if (fs::is_directory(input)) {
+      for (const auto& entry : fs::directory_iterator(input)) {
+        if (entry.path().extension() == ".onol") files.push_back(entry.path());
+      }
+      std::sort(files.begin(), files.end());
+    } else {
+      files.push_back(input);
+    }
+    for (const fs::path& file : files) {
+      programs.push_back({file.stem().string(), file, {}});
+    }
+  }
+
+  // The large generated program stresses the tokenizer and parser; it is
+  // written out on every invocation rather than kept in the repository.
+  if (options.generatedBytes > 0) {
+    fs::path path = fs::temp_directory_path() / "onol-generated.onol";
+    std::ofstream(path, std::ios::binary)
+        << generateSource(options.generatedBytes);
+    programs.push_back({"generated", path, {}});
+  }
+  return programs;
+}
+
+int main(int argc, const char* argv[]) {
+  Options options = parseOptions(argc, argv);
+  std::vector<Program> programs = collectPrograms(options);
+
+  for (Program& program : programs) {
+    for (int run = 0; run < options.runs; run++) {
+      std::optional<Sample> sample = runOnce(options, program.path);
+      if (!sample) return 70;
+      program.samples.push_back(*sample);
+    }
+
+    std::vector<double> wall;
+    for (const Sample& sample : program.samples) wall.push_back(sample.wallMs);
+    std::sort(wall.begin(), wall.end());
+    std::cout << std::left << std::setw(16) << program.name << std::right
+              << std::fixed << std::setprecision(2) << std::setw(10)
+              << wall[wall.size() / 2] << " ms median\n";
+  }
+
+  std::ofstream out(options.output);
+  if (!out) {
+    std::cerr << "Could not open " << options.output << ".\n";
+    return 74;
+  }
+  writeJson(out, options, programs);
+  return 0;
+}
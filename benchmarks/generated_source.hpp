@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Deterministic onol source of at least `minBytes` bytes. It cycles through
+// declarations and expressions of every literal type so the tokenizer and
+// parser see a realistic mix of tokens.
+inline std::string generateSource(std::size_t minBytes) {
+  std::string source;
+  for (std::size_t n = 0; source.size() < minBytes; n++) {
+    std::string id = std::to_string(n);
+    source += "int v" + id + " = " + id + " * 3 + 7\n";
+    source += "double w" + id + " = v" + id + " / 2.5 - 0.125\n";
+    source += "string s" + id + " = \"name " + id + "\" + \"suffix\"\n";
+    source += "bool b" + id + " = (v" + id + " >= 10) == !false; w" + id +
+              " = w" + id + " * -1.5\n";
+  }
+  return source;
+}
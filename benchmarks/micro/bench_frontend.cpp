@@ -0,0 +1,48 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <memory>
+#include <string>
+
+#include "bench_sources.hpp"
+#include "bytecode.hpp"
+#include "parser.hpp"
+#include "tokenizer.hpp"
+
+// Benchmark names carry the size of their workload, so throughput is that
+// size divided by the mean time.
+static constexpr std::size_t SOURCE_BYTES = 1 << 20;
+
+TEST_CASE("Tokenizer throughput", "[bench][tokenizer]") {
+  std::string source = generateSource(SOURCE_BYTES);
+
+  BENCHMARK("scanToken " + std::to_string(source.size()) + " bytes") {
+    Tokenizer tokenizer(source);
+    std::size_t tokens = 0;
+    while (tokenizer.scanToken().type != TokenType::TEOF) {
+      tokens++;
+    }
+    return tokens;
+  };
+
+  TokenBuffer buffer;
+  BENCHMARK("scanAll " + std::to_string(source.size()) + " bytes") {
+    Tokenizer(source).scanAll(buffer);
+    return buffer.size();
+  };
+}
+
+TEST_CASE("Parser throughput", "[bench][parser]") {
+  std::string source = generateSource(SOURCE_BYTES);
+  std::size_t tokens = countTokens(source);
+  Parser parser;
+
+  // Parsing declares the same globals every time, so only the first run
+  // grows the global table.
+  REQUIRE(parser.parse(source, std::make_shared<Bytecode>()));
+
+  BENCHMARK("parse " + std::to_string(tokens) + " tokens") {
+    auto bytecode = std::make_shared<Bytecode>();
+    return parser.parse(source, bytecode);
+  };
+}
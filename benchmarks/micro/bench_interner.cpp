@@ -0,0 +1,103 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "heap.hpp"
+#include "interned_strings.hpp"
+#include "operations.hpp"
+
+static constexpr std::size_t NAMES = 1024;
+
+static std::vector<std::string> makeNames(const std::string& prefix,
+                                          std::size_t first,
+                                          std::size_t count) {
+  std::vector<std::string> names;
+  names.reserve(count);
+  for (std::size_t i = first; i < first + count; i++) {
+    names.push_back(prefix + std::to_string(i));
+  }
+  return names;
+}
+
+TEST_CASE("String interner", "[bench][interner]") {
+  std::vector<std::string> interned = makeNames("name", 0, NAMES);
+  for (const std::string& name : interned) {
+    getOrIntern(std::string_view(name));
+  }
+
+  BENCHMARK("getOrIntern hit x1024") {
+    ObjString* last = nullptr;
+    for (const std::string& name : interned) {
+      last = getOrIntern(std::string_view(name));
+    }
+    return last;
+  };
+
+  // Every run needs names that were never interned, so they are made
+  // before the clock starts.
+  std::size_t next = 0;
+  BENCHMARK_ADVANCED("getOrIntern miss x1024")
+  (Catch::Benchmark::Chronometer meter) {
+    std::vector<std::string> fresh =
+        makeNames("fresh", next, meter.runs() * NAMES);
+    next += fresh.size();
+
+    meter.measure([&](int run) {
+      ObjString* last = nullptr;
+      for (std::size_t i = 0; i < NAMES; i++) {
+        last = getOrIntern(std::string_view(fresh[run * NAMES + i]));
+      }
+      return last;
+    });
+  };
+
+  clearInternedStrings();
+}
+
+TEST_CASE("String concatenation", "[bench][interner]") {
+  Type hello = getOrIntern("hello");
+  Type world = getOrIntern(" world");
+  Type number = Type(42);
+  Type longString = getOrIntern(std::string(1024, 'x'));
+
+  BENCHMARK("binaryOperation short + short") {
+    return binaryOperation(std::plus<>(), hello, world);
+  };
+
+  BENCHMARK("binaryOperation string + int") {
+    return binaryOperation(std::plus<>(), hello, number);
+  };
+
+  BENCHMARK("binaryOperation 1 KiB + 1 KiB") {
+    return binaryOperation(std::plus<>(), longString, longString);
+  };
+
+  BENCHMARK("concatenateStrings short + short") {
+    return concatenateStrings(hello, world);
+  };
+
+  clearInternedStrings();
+}
+
+// Strings nothing refers to, as most concatenation results are.
+TEST_CASE("Heap allocation", "[bench][heap]") {
+  Heap heap;
+  std::size_t next = 0;
+  BENCHMARK_ADVANCED("allocateString short-lived x1024")
+  (Catch::Benchmark::Chronometer meter) {
+    std::vector<std::string> fresh =
+        makeNames("temporary ", next, meter.runs() * NAMES);
+    next += fresh.size();
+
+    meter.measure([&](int run) {
+      ObjString* last = nullptr;
+      for (std::size_t i = 0; i < NAMES; i++) {
+        last = heap.allocateString(fresh[run * NAMES + i]);
+      }
+      return last;
+    });
+  };
+}
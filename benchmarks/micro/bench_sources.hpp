@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+#include "generated_source.hpp"
+#include "tokenizer.hpp"
+
+inline std::size_t countTokens(std::string_view source) {
+  Tokenizer tokenizer(source);
+  std::size_t count = 1;
+  while (tokenizer.scanToken().type != TokenType::TEOF) {
+    count++;
+  }
+  return count;
+}
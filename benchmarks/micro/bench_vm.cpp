@@ -0,0 +1,130 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <memory>
+#include <string>
+
+#include "bytecode.hpp"
+#include "vm.hpp"
+
+static constexpr int REPETITIONS = 1000;
+
+static const char* PRELUDE =
+    "let a = 1\nlet b = 2\nlet x = 1.5\nlet y = 2.5\n"
+    "let s = \"s\"\nlet t = \"t\"\nlet flag = true\n"
+    "int i = 3\nint j = 4\ndouble d = 1.5\ndouble e = 2.5\nstring u = \"u\"\n";
+
+// A statement whose steady-state execution is dominated by `opCode`. Each
+// workload also loads the operands and pops the result, so the `POP`
+// workload (a bare global load) is the baseline to subtract.
+struct Workload {
+  OpCode opCode;
+  const char* statement;
+  bool optimize;
+};
+
+static const Workload WORKLOADS[] = {
+    {OpCode::POP, "a", false},
+    {OpCode::CONSTANT, "1", false},
+    {OpCode::NUL, "nil", false},
+    {OpCode::TRUE, "true", false},
+    {OpCode::FALSE, "false", false},
+    {OpCode::DEFINE_GLOBAL, "let v = 1", false},
+    {OpCode::SET_GLOBAL, "a = 1", false},
+    {OpCode::GET_GLOBAL_QUICK, "a + b", false},
+    {OpCode::ADD, "a + x", false},
+    {OpCode::SUBTRACT, "a - x", false},
+    {OpCode::MULTIPLY, "a * x", false},
+    {OpCode::DIVIDE, "x / a", false},
+    {OpCode::NEGATE, "-a", false},
+    {OpCode::NOT, "!flag", false},
+    {OpCode::EQUAL, "a == b", false},
+    {OpCode::NOT_EQUAL, "a != b", false},
+    {OpCode::GREATER, "a > x", false},
+    {OpCode::LESS, "a < x", false},
+    {OpCode::GREATER_EQUAL, "a >= x", false},
+    {OpCode::LESS_EQUAL, "a <= x", false},
+    {OpCode::ADD_INT, "i + j", false},
+    {OpCode::SUBTRACT_INT, "i - j", false},
+    {OpCode::MULTIPLY_INT, "i * j", false},
+    {OpCode::DIVIDE_INT, "i / j", false},
+    {OpCode::ADD_DOUBLE, "d + e", false},
+    {OpCode::SUBTRACT_DOUBLE, "d - e", false},
+    {OpCode::MULTIPLY_DOUBLE, "d * e", false},
+    {OpCode::DIVIDE_DOUBLE, "d / e", false},
+    {OpCode::GREATER_INT, "i > j", false},
+    {OpCode::LESS_INT, "i < j", false},
+    {OpCode::GREATER_EQUAL_INT, "i >= j", false},
+    {OpCode::LESS_EQUAL_INT, "i <= j", false},
+    {OpCode::GREATER_DOUBLE, "d > e", false},
+    {OpCode::LESS_DOUBLE, "d < e", false},
+    {OpCode::GREATER_EQUAL_DOUBLE, "d >= e", false},
+    {OpCode::LESS_EQUAL_DOUBLE, "d <= e", false},
+    {OpCode::NEGATE_INT, "-i", false},
+    {OpCode::NEGATE_DOUBLE, "-d", false},
+    {OpCode::CONCAT_STR, "u + u", false},
+    {OpCode::COERCE, "i = a", false},
+    {OpCode::ADD_CONSTANT, "a + 1", true},
+    {OpCode::SUBTRACT_CONSTANT, "a - 1", true},
+    {OpCode::MULTIPLY_CONSTANT, "a * 2", true},
+    {OpCode::DIVIDE_CONSTANT, "a / 2", true},
+    {OpCode::ADD_GLOBALS, "a + b", true},
+    {OpCode::SUBTRACT_GLOBALS, "a - b", true},
+    {OpCode::MULTIPLY_GLOBALS, "a * b", true},
+    {OpCode::DIVIDE_GLOBALS, "a / b", true},
+    {OpCode::SET_GLOBAL_POP, "a = 1", true},
+    {OpCode::ADD_INT_QUICK, "a + b", false},
+    {OpCode::SUBTRACT_INT_QUICK, "a - b", false},
+    {OpCode::MULTIPLY_INT_QUICK, "a * b", false},
+    {OpCode::DIVIDE_INT_QUICK, "a / b", false},
+    {OpCode::ADD_DOUBLE_QUICK, "x + y", false},
+    {OpCode::SUBTRACT_DOUBLE_QUICK, "x - y", false},
+    {OpCode::MULTIPLY_DOUBLE_QUICK, "x * y", false},
+    {OpCode::DIVIDE_DOUBLE_QUICK, "x / y", false},
+    {OpCode::GREATER_INT_QUICK, "a > b", false},
+    {OpCode::LESS_INT_QUICK, "a < b", false},
+    {OpCode::GREATER_EQUAL_INT_QUICK, "a >= b", false},
+    {OpCode::LESS_EQUAL_INT_QUICK, "a <= b", false},
+    {OpCode::GREATER_DOUBLE_QUICK, "x > y", false},
+    {OpCode::LESS_DOUBLE_QUICK, "x < y", false},
+    {OpCode::GREATER_EQUAL_DOUBLE_QUICK, "x >= y", false},
+    {OpCode::LESS_EQUAL_DOUBLE_QUICK, "x <= y", false},
+    {OpCode::CONCAT_STR_QUICK, "s + t", false},
+};
+
+static bool containsOpCode(Bytecode& chunk, OpCode opCode) {
+  for (std::size_t offset = 0; offset < chunk.count();) {
+    if (chunk.getOpCode(offset) == opCode) return true;
+    offset += instructionLength(chunk.getOpCode(offset));
+  }
+  return false;
+}
+
+// Each benchmark runs REPETITIONS copies of its statement, so its mean time
+// in microseconds is the time per statement in nanoseconds.
+TEST_CASE("VM dispatch per opcode", "[bench][vm]") {
+  VM vm;
+  REQUIRE(vm.interpret(PRELUDE) == InterpretResult::INTERPRET_OK);
+
+  for (const Workload& workload : WORKLOADS) {
+    std::string source;
+    for (int n = 0; n < REPETITIONS; n++) {
+      source += workload.statement;
+      source += "\n";
+    }
+
+    vm.setOptimize(workload.optimize);
+    std::shared_ptr<Bytecode> chunk = vm.compile(source);
+    REQUIRE(chunk);
+
+    // The first run quickens the chunk into its steady state.
+    REQUIRE(vm.interpret(chunk) == InterpretResult::INTERPRET_OK);
+    INFO(opCodeName(workload.opCode));
+    REQUIRE(containsOpCode(*chunk, workload.opCode));
+
+    BENCHMARK(std::string(opCodeName(workload.opCode)) + " x" +
+              std::to_string(REPETITIONS)) {
+      return vm.interpret(chunk);
+    };
+  }
+}
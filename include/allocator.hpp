@@ -1,6 +1,9 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
 
 void *reallocate(void *pointer, [[maybe_unused]] size_t oldSize,
                  size_t newSize);
@@ -56,6 +59,59 @@ void Allocator<T>::deallocate(T *pointer, std::size_t n) noexcept {
   reallocate(static_cast<void *>(pointer), n * sizeof(T), 0);
 }
 
+// A fixed block handed out by advancing a pointer and reclaimed only as a
+// whole by reset(). Destructors of what was placed in it never run. The
+// block itself comes from reallocate.
+class BumpAllocator {
+ public:
+  static constexpr std::size_t ALIGNMENT = alignof(std::max_align_t);
+
+  explicit BumpAllocator(std::size_t capacity);
+  BumpAllocator(const BumpAllocator &) = delete;
+  BumpAllocator &operator=(const BumpAllocator &) = delete;
+  ~BumpAllocator();
+
+  // Returns nullptr when the block is full.
+  void *allocate(std::size_t size) {
+    size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    if (size > static_cast<std::size_t>(end - next)) {
+      return nullptr;
+    }
+    void *memory = next;
+    next += size;
+    return memory;
+  }
+
+  void reset() {
+    next = start;
+  }
+
+  // Overwrites what was handed out since the last reset, so stale
+  // pointers into the block read garbage instead of old contents.
+  void scrub(unsigned char byte) {
+    std::memset(start, byte, used());
+  }
+
+  bool contains(const void *pointer) const {
+    auto address = reinterpret_cast<std::uintptr_t>(pointer);
+    return address >= reinterpret_cast<std::uintptr_t>(start) &&
+           address < reinterpret_cast<std::uintptr_t>(end);
+  }
+
+  std::size_t used() const {
+    return static_cast<std::size_t>(next - start);
+  }
+
+  std::size_t capacity() const {
+    return static_cast<std::size_t>(end - start);
+  }
+
+ private:
+  char *start;
+  char *next;
+  char *end;
+};
+
 template <typename T, typename... Args>
 T *allocateAndConstruct(Args &&...args) {
   Allocator<T> alloc;
@@ -3,9 +3,15 @@
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include "allocator.hpp"
+#include "globals.hpp"
+#include "interpreter_error.hpp"
+#include "line_table.hpp"
 #include "types.hpp"
 
 enum class OpCode : uint8_t {
@@ -33,32 +39,164 @@ enum class OpCode : uint8_t {
   LESS_EQUAL,
   NOT_EQUAL,
   POP,
-  RETURN
+  RETURN,
+
+  // Type-specialized forms, emitted when the compiler can prove the operand
+  // types. They skip the dynamic type checks of the generic opcodes.
+  ADD_INT,
+  SUBTRACT_INT,
+  MULTIPLY_INT,
+  DIVIDE_INT,
+  ADD_DOUBLE,
+  SUBTRACT_DOUBLE,
+  MULTIPLY_DOUBLE,
+  DIVIDE_DOUBLE,
+  GREATER_INT,
+  LESS_INT,
+  GREATER_EQUAL_INT,
+  LESS_EQUAL_INT,
+  GREATER_DOUBLE,
+  LESS_DOUBLE,
+  GREATER_EQUAL_DOUBLE,
+  LESS_EQUAL_DOUBLE,
+  NEGATE_INT,
+  NEGATE_DOUBLE,
+  CONCAT_STR,
+  COERCE,
+
+  // Superinstructions produced by the optimizer.
+  ADD_CONSTANT,
+  SUBTRACT_CONSTANT,
+  MULTIPLY_CONSTANT,
+  DIVIDE_CONSTANT,
+  ADD_GLOBALS,
+  SUBTRACT_GLOBALS,
+  MULTIPLY_GLOBALS,
+  DIVIDE_GLOBALS,
+  SET_GLOBAL_POP,
+
+  // Quickened forms the VM rewrites generic opcodes into after observing
+  // their operands. Binary forms guard on the operand types and rewrite
+  // themselves back to the generic opcode when the guard fails.
+  ADD_INT_QUICK,
+  SUBTRACT_INT_QUICK,
+  MULTIPLY_INT_QUICK,
+  DIVIDE_INT_QUICK,
+  ADD_DOUBLE_QUICK,
+  SUBTRACT_DOUBLE_QUICK,
+  MULTIPLY_DOUBLE_QUICK,
+  DIVIDE_DOUBLE_QUICK,
+  GREATER_INT_QUICK,
+  LESS_INT_QUICK,
+  GREATER_EQUAL_INT_QUICK,
+  LESS_EQUAL_INT_QUICK,
+  GREATER_DOUBLE_QUICK,
+  LESS_DOUBLE_QUICK,
+  GREATER_EQUAL_DOUBLE_QUICK,
+  LESS_EQUAL_DOUBLE_QUICK,
+  CONCAT_STR_QUICK,
+  GET_GLOBAL_QUICK,
+  GET_GLOBAL_LONG_QUICK,
+
+  OPCODE_COUNT
+};
+
+class BytecodeError : public InterpreterError {
+ public:
+  BytecodeError() = delete;
+  BytecodeError(uint32_t line, const std::string& msg)
+      : InterpreterError(line, msg) {
+  }
+};
+
+std::size_t instructionLength(OpCode opCode);
+const char* opCodeName(OpCode opCode);
+int stackEffect(OpCode opCode);
+// The opcode a quickened form was rewritten from; other opcodes map to
+// themselves.
+OpCode genericOpCode(OpCode opCode);
+// Static type of the result of a generic binary opcode.
+StaticType binaryResultType(OpCode generic, StaticType a, StaticType b);
+
+struct StackDepth {
+  std::size_t max = 0;
+  std::size_t offset = 0;
 };
 
 class Bytecode {
  private:
-  struct LineStart {
-    std::size_t offset;
-    uint32_t line;
-  };
-
   std::vector<std::uint8_t, Allocator<std::uint8_t>> code;
   std::vector<Type, Allocator<Type>> constantPool;
-  std::vector<std::unique_ptr<LineStart>> lines;
+  std::unordered_map<uint64_t, std::size_t> constantAddresses;
+  LineTable lines;
+  std::shared_ptr<GlobalTable> globals;
+
+  // Chunks loaded from a precompiled file run their code straight from the
+  // file mapping, which `mapping` keeps alive. String constants of such a
+  // chunk stay undefined in the pool until they are first read or the chunk
+  // first runs; `lazyStrings` holds their characters until then.
+  std::shared_ptr<void> mapping;
+  uint8_t* mappedCode = nullptr;
+  std::size_t mappedCount = 0;
+  std::vector<std::string_view> lazyStrings;
+  // Kept from the first validation until the code or globals change.
+  // Quickening rewrites opcodes in place without changing their stack use.
+  std::optional<StackDepth> depth;
+
   void addLine(uint32_t line);
+  StaticType constantType(std::size_t address, std::size_t offset);
+  StaticType globalType(std::size_t slot, std::size_t offset);
+  void checkStore(std::size_t slot, StaticType type, std::size_t offset);
+  StaticType checkInstruction(OpCode opCode, std::size_t offset,
+                              const StaticType* inputs);
+
+  inline uint8_t* codeData() {
+    return mappedCode ? mappedCode : code.data();
+  }
 
  public:
   void putRaw(uint8_t byte, uint32_t line);
   void putRaw(std::size_t byte, uint32_t line);
   void putOpCode(OpCode byte, uint32_t line);
   std::size_t putConstant(Type value, uint32_t line);
+  // Returns the address of `value` in the constant pool, adding it only if
+  // an identical constant (same bits: same interned string, same number of
+  // the same type) is not already there.
   std::size_t createConstant(Type value);
+  void truncate(std::size_t newCount);
+  void swapCode(Bytecode& other);
   void free();
   OpCode getOpCode(int index);
   uint8_t getConstantAddress(int index);
   Type getConstant(int address);
+  // The VM's read, without the check for strings not yet interned: run
+  // internLazyStrings first.
+  inline Type readConstant(std::size_t address) const {
+    return constantPool[address];
+  }
+  void internLazyStrings();
   uint32_t getLine(std::size_t address);
   uint8_t* getCodePointer();
+  void setGlobals(std::shared_ptr<GlobalTable> table);
+  GlobalTable* getGlobals();
   std::size_t count();
+  std::size_t constantCount();
+  // Constants as stored: strings of a loaded chunk that were never used are
+  // still undefined.
+  const std::vector<Type, Allocator<Type>>& getConstantPool() const;
+  const LineTable& getLines();
+
+  // Used by the precompiled bytecode loader.
+  void mapCode(std::shared_ptr<void> storage, uint8_t* code, std::size_t count);
+  void appendConstant(Type value);
+  void appendLazyString(std::string_view chars);
+  void setLines(LineTable table);
+
+  // Validates every instruction of the chunk (the VM trusts opcodes, stack
+  // operands, constant and global indices and the operand types of typed
+  // opcodes after this) and returns the deepest operand stack it can reach.
+  // Operand types are checked against the declared types of the globals.
+  StackDepth computeStackDepth();
+  // The result of computeStackDepth, which runs once per chunk.
+  const StackDepth& stackDepth();
 };
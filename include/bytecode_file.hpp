@@ -0,0 +1,28 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "bytecode.hpp"
+#include "globals.hpp"
+
+// Precompiled bytecode files (.onolc). All integers are little-endian:
+//
+//   header     "ONLC", u16 version, u16 opcode count, u32 code size,
+//              u32 constant count, u32 line table size, u32 global count
+//   code       raw instructions, executed in place from the file mapping
+//   constants  u8 tag, then u64 value bits (tag 0) or u32 length + chars
+//              of a string (tag 1)
+//   lines      the line table in the LineTable::encode format
+//   globals    u8 declared type (0xff if undeclared), u32 length + chars of
+//              the name, in slot order
+//
+// Files written by a build with a different opcode set are rejected.
+constexpr uint16_t BYTECODE_FILE_VERSION = 2;
+
+bool isBytecodeFile(const std::string& path);
+void writeBytecodeFile(Bytecode& bytecode, const std::string& path);
+// Maps `path` and returns a chunk that runs against `globals`. Global slots
+// of the file are remapped when the table already assigned them elsewhere.
+std::shared_ptr<Bytecode> loadBytecodeFile(
+    const std::string& path, std::shared_ptr<GlobalTable> globals);
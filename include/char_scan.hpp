@@ -0,0 +1,175 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#define ONOL_SIMD_SCAN
+#include <immintrin.h>
+#endif
+
+// Block-at-a-time character scanning for the tokenizer. Each helper returns
+// the first index in [pos, end) that stops the scan, or `end`. Whole blocks
+// are classified with SSE2 (16 bytes) or, when the compiler targets it, AVX2
+// (32 bytes); the tail shorter than a block is scanned one character at a
+// time, so no helper ever reads at or past `end`.
+
+inline bool isBlankChar(char ch) {
+  return ch == ' ' || ch == '\t' || ch == '\r';
+}
+
+inline bool isIdentifierChar(char ch) {
+  return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') ||
+         (ch >= '0' && ch <= '9') || ch == '_';
+}
+
+namespace simd {
+
+#if defined(__AVX2__)
+using Block = __m256i;
+inline constexpr std::size_t WIDTH = 32;
+
+inline Block load(const char* at) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(at));
+}
+inline Block splat(char ch) {
+  return _mm256_set1_epi8(ch);
+}
+inline Block eq(Block a, Block b) {
+  return _mm256_cmpeq_epi8(a, b);
+}
+inline Block gt(Block a, Block b) {
+  return _mm256_cmpgt_epi8(a, b);
+}
+inline Block either(Block a, Block b) {
+  return _mm256_or_si256(a, b);
+}
+inline Block both(Block a, Block b) {
+  return _mm256_and_si256(a, b);
+}
+inline uint32_t mask(Block a) {
+  return static_cast<uint32_t>(_mm256_movemask_epi8(a));
+}
+#elif defined(ONOL_SIMD_SCAN)
+using Block = __m128i;
+inline constexpr std::size_t WIDTH = 16;
+
+inline Block load(const char* at) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(at));
+}
+inline Block splat(char ch) {
+  return _mm_set1_epi8(ch);
+}
+inline Block eq(Block a, Block b) {
+  return _mm_cmpeq_epi8(a, b);
+}
+inline Block gt(Block a, Block b) {
+  return _mm_cmpgt_epi8(a, b);
+}
+inline Block either(Block a, Block b) {
+  return _mm_or_si128(a, b);
+}
+inline Block both(Block a, Block b) {
+  return _mm_and_si128(a, b);
+}
+inline uint32_t mask(Block a) {
+  return static_cast<uint32_t>(_mm_movemask_epi8(a));
+}
+#endif
+
+#ifdef ONOL_SIMD_SCAN
+inline constexpr uint32_t FULL = WIDTH == 32 ? ~uint32_t{0} : 0xffff;
+
+// Set bits for the bytes in [lo, hi]. Comparisons are signed, which is
+// fine for ASCII ranges: bytes >= 0x80 are negative and never match.
+inline Block inRange(Block bytes, char lo, char hi) {
+  return both(gt(bytes, splat(lo - 1)), gt(splat(hi + 1), bytes));
+}
+
+inline uint32_t blankMask(Block bytes) {
+  return mask(either(either(eq(bytes, splat(' ')), eq(bytes, splat('\t'))),
+                     eq(bytes, splat('\r'))));
+}
+
+inline uint32_t identifierMask(Block bytes) {
+  Block lower = either(bytes, splat(0x20));
+  return mask(either(either(inRange(lower, 'a', 'z'), inRange(bytes, '0', '9')),
+                     eq(bytes, splat('_'))));
+}
+#endif
+
+}  // namespace simd
+
+// Skips ' ', '\t' and '\r'; newlines end the scan.
+inline std::size_t scanBlanks(const char* s, std::size_t pos,
+                              std::size_t end) {
+#ifdef ONOL_SIMD_SCAN
+  for (; pos + simd::WIDTH <= end; pos += simd::WIDTH) {
+    uint32_t stops = ~simd::blankMask(simd::load(s + pos)) & simd::FULL;
+    if (stops) return pos + std::countr_zero(stops);
+  }
+#endif
+  while (pos < end && isBlankChar(s[pos])) pos++;
+  return pos;
+}
+
+// Skips blanks and newlines, adding the newlines skipped to `newlines`.
+inline std::size_t scanWhitespace(const char* s, std::size_t pos,
+                                  std::size_t end, std::size_t& newlines) {
+#ifdef ONOL_SIMD_SCAN
+  for (; pos + simd::WIDTH <= end; pos += simd::WIDTH) {
+    simd::Block bytes = simd::load(s + pos);
+    uint32_t lineEnds = simd::mask(simd::eq(bytes, simd::splat('\n')));
+    uint32_t stops = ~(simd::blankMask(bytes) | lineEnds) & simd::FULL;
+    if (stops) {
+      int stop = std::countr_zero(stops);
+      newlines += std::popcount(lineEnds & ((uint32_t{1} << stop) - 1));
+      return pos + stop;
+    }
+    newlines += std::popcount(lineEnds);
+  }
+#endif
+  for (; pos < end && (isBlankChar(s[pos]) || s[pos] == '\n'); pos++) {
+    if (s[pos] == '\n') newlines++;
+  }
+  return pos;
+}
+
+// Skips identifier characters: letters, digits and '_'.
+inline std::size_t scanIdentifier(const char* s, std::size_t pos,
+                                  std::size_t end) {
+#ifdef ONOL_SIMD_SCAN
+  for (; pos + simd::WIDTH <= end; pos += simd::WIDTH) {
+    uint32_t stops = ~simd::identifierMask(simd::load(s + pos)) & simd::FULL;
+    if (stops) return pos + std::countr_zero(stops);
+  }
+#endif
+  while (pos < end && isIdentifierChar(s[pos])) pos++;
+  return pos;
+}
+
+// Finds the next `stop` character, adding the newlines passed on the way to
+// `newlines`. Used for string, line comment and block comment bodies.
+inline std::size_t scanUntil(const char* s, std::size_t pos, std::size_t end,
+                             char stop, std::size_t& newlines) {
+#ifdef ONOL_SIMD_SCAN
+  simd::Block stopChar = simd::splat(stop);
+  simd::Block newline = simd::splat('\n');
+  for (; pos + simd::WIDTH <= end; pos += simd::WIDTH) {
+    simd::Block bytes = simd::load(s + pos);
+    uint32_t lineEnds = simd::mask(simd::eq(bytes, newline));
+    uint32_t stops = simd::mask(simd::eq(bytes, stopChar));
+    if (stops) {
+      int at = std::countr_zero(stops);
+      newlines += std::popcount(lineEnds & ((uint32_t{1} << at) - 1));
+      return pos + at;
+    }
+    newlines += std::popcount(lineEnds);
+  }
+#endif
+  for (; pos < end && s[pos] != stop; pos++) {
+    if (s[pos] == '\n') newlines++;
+  }
+  return pos;
+}
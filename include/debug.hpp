@@ -1,9 +1,11 @@
 #pragma once
 
-#include "bytecode.hpp"
+#include <iostream>
+#include <string>
 
-#define DEBUG_PRINT_CODE
-#define DEBUG_TRACE_EXECUTION
+#include "bytecode.hpp"
 
-void disassembleBytecode(Bytecode& bytecode, const std::string& name);
-int disassembleInstruction(Bytecode& bytecode, uint32_t offset);
+void disassembleBytecode(Bytecode& bytecode, const std::string& name,
+                         std::ostream& out = std::cout);
+int disassembleInstruction(Bytecode& bytecode, uint32_t offset,
+                           std::ostream& out = std::cout);
@@ -1,9 +1,13 @@
 #pragma once
 
+#include <bit>
+#include <cstdint>
 #include <cstring>
 #include <functional>
 #include <memory>
+#include <new>
 #include <string>
+#include <string_view>
 
 #include "allocator.hpp"
 
@@ -27,38 +31,116 @@ inline String fromStdString(const std::string& str) {
 }
 
 struct Object {
+  // Set on objects owned by a VM heap, which collects them once they are
+  // unreachable. Other objects, such as the compiler's interned strings,
+  // are shared and never marked.
+  bool managed = false;
+  bool marked = false;
+
   virtual ~Object() = default;
+  // Bytes of the allocation holding the object.
+  virtual std::size_t allocationSize() const = 0;
   virtual std::string toString() const = 0;
   virtual bool operator==(const Object& other) const = 0;
 };
 
+// An immutable string. The characters follow the object in the same
+// allocation, NUL-terminated, and the hash is computed once at creation.
 struct ObjString : Object {
-  String value;
+  static ObjString* create(std::string_view chars) {
+    return create(chars, hashOf(chars));
+  }
 
-  ObjString(String value) : value(std::move(value)) {
+  static ObjString* create(std::string_view chars, std::size_t hash) {
+    void* memory = reallocate(nullptr, 0, sizeFor(chars.size()));
+    if (!memory) {
+      throw std::bad_alloc();
+    }
+    return construct(memory, chars, hash);
   }
 
-  ObjString(const std::string& str) : value(str.begin(), str.end()) {
+  // Builds a string in `memory`, which must hold sizeFor(chars.size())
+  // bytes.
+  static ObjString* construct(void* memory, std::string_view chars,
+                              std::size_t hash) {
+    auto* string = new (memory) ObjString(chars.size(), hash);
+    char* storage = reinterpret_cast<char*>(string + 1);
+    std::memcpy(storage, chars.data(), chars.size());
+    storage[chars.size()] = '\0';
+    return string;
   }
 
-  ObjString(std::string_view sv) : value(sv.begin(), sv.end()) {
+  static void destroy(ObjString* string) {
+    if (string) {
+      std::size_t size = string->allocationSize();
+      string->~ObjString();
+      reallocate(string, size, 0);
+    }
   }
 
-  ObjString(const char* cstr) : value(cstr, cstr + std::strlen(cstr)) {
+  static constexpr std::size_t sizeFor(std::size_t length) {
+    return sizeof(ObjString) + length + 1;
   }
 
-  std::string toString() const override {
-    return std::string(value.begin(), value.end());
+  // Hashes 8-byte words by multiplying and rotating the product's high half,
+  // which depends on every input bit, into the low bits a hash table masks
+  // with. The remaining bytes are taken FNV-1a style.
+  static std::size_t hashOf(std::string_view chars) {
+    constexpr uint64_t WORD_MULTIPLIER = 0x9e3779b97f4a7c15;
+    constexpr uint64_t BYTE_MULTIPLIER = 1099511628211u;
+    uint64_t hash = 14695981039346656037u ^ chars.size();
+    const char* data = chars.data();
+    std::size_t i = 0;
+    for (; i + sizeof(uint64_t) <= chars.size(); i += sizeof(uint64_t)) {
+      uint64_t word;
+      std::memcpy(&word, data + i, sizeof(word));
+      hash = std::rotl((hash ^ word) * WORD_MULTIPLIER, 32);
+    }
+    for (; i < chars.size(); i++) {
+      hash = (hash ^ static_cast<unsigned char>(data[i])) * BYTE_MULTIPLIER;
+    }
+    return static_cast<std::size_t>(hash);
+  }
+
+  ObjString(const ObjString&) = delete;
+  ObjString& operator=(const ObjString&) = delete;
+
+  std::size_t allocationSize() const override {
+    return sizeFor(size);
+  }
+
+  std::size_t length() const {
+    return size;
+  }
+
+  std::size_t hash() const {
+    return hashCode;
   }
 
   const char* toChar() const {
-    return value.c_str();
+    return reinterpret_cast<const char*>(this + 1);
+  }
+
+  std::string_view view() const {
+    return {toChar(), size};
+  }
+
+  std::string toString() const override {
+    return std::string(view());
   }
 
   bool operator==(const Object& other) const override {
     if (auto* otherString = dynamic_cast<const ObjString*>(&other)) {
-      return value == otherString->value;
+      return hashCode == otherString->hashCode &&
+             view() == otherString->view();
     }
     return false;
   }
+
+ private:
+  std::size_t size;
+  std::size_t hashCode;
+
+  ObjString(std::size_t size, std::size_t hash) : size(size), hashCode(hash) {
+  }
 };
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "allocator.hpp"
+#include "types.hpp"
+
+// Global variables resolved to dense slots. The compiler maps each interned
+// name to a slot once; at runtime a global access is a plain index into
+// `values`, where an undefined sentinel marks variables not yet defined.
+// The first declaration of a global fixes its static type, which lets the
+// compiler specialize code that reads it.
+class GlobalTable {
+ private:
+  std::unordered_map<ObjString*, uint32_t> slots;
+  std::vector<ObjString*> names;
+  std::vector<std::optional<StaticType>> types;
+  std::vector<Type, Allocator<Type>> values;
+
+ public:
+  std::size_t resolve(ObjString* name);
+  std::optional<std::size_t> find(ObjString* name) const;
+  ObjString* getName(std::size_t slot) const;
+  std::size_t count() const;
+
+  std::optional<StaticType> getDeclaredType(std::size_t slot) const;
+  StaticType getType(std::size_t slot) const;
+  void declare(std::size_t slot, StaticType type);
+  void undeclare(std::size_t slot);
+
+  inline Type* getValues() {
+    return values.data();
+  }
+};
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+#include "allocator.hpp"
+#include "interned_strings.hpp"
+#include "types.hpp"
+
+// Objects created while a VM runs, in two generations. New objects are
+// bump-allocated in a nursery; when it fills, a minor collection copies the
+// ones still referenced into the old generation and empties it. The old
+// generation is reclaimed by a precise mark-and-sweep collector, started
+// when promotion or a large allocation takes it past a threshold set after
+// the previous collection to a multiple of the bytes that survived it. A
+// full collection also empties the nursery.
+//
+// Roots are reported by the owner through a callback that calls markValue
+// on every value rootScan() asks for; the value is updated if its object
+// moved. In a minor collection the only old-to-young references are those
+// the owner recorded with its write barrier (see isYoung), so it need only
+// report those along with its stack.
+//
+// In incremental mode the old generation is instead collected by a cycle of
+// bounded slices run between allocations. Marking is tri-color: white
+// objects are unmarked, gray ones are marked and wait in a worklist, black
+// ones are marked and scanned. Roots are scanned when the cycle starts;
+// after that the owner must pass every value it stores into a root other
+// than its stack to writeBarrier, and the stack is scanned again when
+// marking ends. Objects allocated while marking are black.
+//
+// Strings are interned weakly: allocating a string equal to a live one,
+// or to a shared interned one, returns that string, so equal strings stay
+// one object while they are reachable and are still reclaimed after.
+class Heap {
+ public:
+  using RootMarker = std::function<void(Heap&)>;
+
+  enum class RootScan {
+    // The stack and the roots remembered as holding young objects.
+    YOUNG,
+    ALL,
+    // Only the stack, which has no write barrier.
+    STACK,
+  };
+
+  // Work allowed in one incremental slice; a zero limit is no limit.
+  struct SliceBudget {
+    std::size_t objects = 1000;
+    std::chrono::microseconds time{0};
+  };
+
+  // A pause is one stretch of collector work the owner waits for: a minor
+  // or full collection or an incremental slice, with any collection it
+  // starts.
+  struct PauseStats {
+    std::size_t count = 0;
+    std::chrono::nanoseconds total{0};
+    std::chrono::nanoseconds max{0};
+  };
+
+  static constexpr std::size_t MIN_THRESHOLD = 1 << 20;
+  static constexpr std::size_t GROWTH_FACTOR = 2;
+  static constexpr std::size_t NURSERY_SIZE = 256 << 10;
+  // Larger objects are allocated directly in the old generation.
+  static constexpr std::size_t LARGE_OBJECT = 4 << 10;
+  // Bytes allocated between incremental slices.
+  static constexpr std::size_t SLICE_INTERVAL = 16 << 10;
+
+  Heap() = default;
+  Heap(const Heap&) = delete;
+  Heap& operator=(const Heap&) = delete;
+  ~Heap();
+
+  void setRootMarker(RootMarker marker);
+  // Runs a minor and then a full collection (or incremental slice) before
+  // every allocation, and scrubs the nursery as it is emptied; used to
+  // flush out missing roots and write barriers. On by default in
+  // ONOL_STRESS_GC builds.
+  void setStressMode(bool enabled);
+  void setIncremental(bool enabled, SliceBudget budget);
+
+  ObjString* allocateString(std::string_view chars);
+
+  inline bool isYoung(const Type& value) const {
+    return isObject(value) && nursery.contains(asObject(value));
+  }
+
+  RootScan rootScan() const {
+    return scan;
+  }
+
+  // True while the roots being asked for are those of a collection that
+  // empties the nursery, after which no root refers to it.
+  bool emptyingNursery() const {
+    return emptying;
+  }
+
+  bool cycleInProgress() const {
+    return phase != Phase::IDLE;
+  }
+
+  // Shades an old object stored into a root while marking, so a value
+  // moved into a root scanned earlier is not missed.
+  inline void writeBarrier(const Type& value) {
+    if (phase == Phase::MARKING && isObject(value) && !isYoung(value)) {
+      markObject(asObject(value));
+    }
+  }
+
+  void markValue(Type& value);
+  void markObject(Object* object);
+  void collect();
+  void collectNursery();
+  // Runs one incremental slice, starting a cycle if none is in progress.
+  void collectSlice();
+
+  std::size_t bytesAllocated() const {
+    return allocated + youngAllocated;
+  }
+
+  std::size_t objectCount() const {
+    return objects.size() + youngStrings.size();
+  }
+
+  std::size_t stringCount() const {
+    return strings.size() + youngStrings.size();
+  }
+
+  std::size_t collections() const {
+    return collectionCount;
+  }
+
+  std::size_t nurseryCollections() const {
+    return nurseryCollectionCount;
+  }
+
+  const PauseStats& pauses() const {
+    return pauseStats;
+  }
+
+  void report(std::ostream& out) const;
+
+ private:
+  enum class Phase { IDLE, MARKING, SWEEPING };
+  class PauseTimer;
+  class SliceDeadline;
+
+  BumpAllocator nursery{NURSERY_SIZE};
+  // Every object in the nursery is a string, so the young string table
+  // doubles as its object list.
+  WeakStringTable youngStrings;
+  std::vector<Object*, Allocator<Object*>> objects;
+  WeakStringTable strings;
+  RootMarker markRoots;
+  std::size_t allocated = 0;
+  std::size_t youngAllocated = 0;
+  std::size_t threshold = MIN_THRESHOLD;
+  std::size_t collectionCount = 0;
+  std::size_t nurseryCollectionCount = 0;
+  RootScan scan = RootScan::ALL;
+  bool emptying = false;
+  bool fullCollection = false;
+#ifdef ONOL_STRESS_GC
+  bool stress = true;
+#else
+  bool stress = false;
+#endif
+
+  bool incremental = false;
+  SliceBudget budget;
+  Phase phase = Phase::IDLE;
+  std::vector<Object*, Allocator<Object*>> gray;
+  // While sweeping, objects[0, sweepKept) survived, objects[sweepCursor,
+  // sweepEnd) are still to be swept and later ones were allocated since.
+  std::size_t sweepKept = 0;
+  std::size_t sweepCursor = 0;
+  std::size_t sweepEnd = 0;
+  std::size_t sinceSlice = 0;
+  PauseStats pauseStats;
+  int pauseDepth = 0;
+
+  void* allocateOld(std::size_t size);
+  void reserveObject();
+  ObjString* addOldString(void* memory, std::string_view chars,
+                          std::size_t hash);
+  ObjString* promote(ObjString* string);
+  void emptyNursery();
+  void free(Object* object);
+  void sweep();
+  void scanRoots(RootScan roots, bool emptiesNursery);
+  void collectOld();
+  void startCycle();
+  bool markSlice(SliceDeadline& deadline);
+  void finishMarking();
+  bool sweepSlice(SliceDeadline& deadline);
+  void finishCycle();
+  void finishCollection();
+};
@@ -1,15 +1,78 @@
-#include <unordered_map>
-
-#include "allocator.hpp"
-#include "dynamic_types.hpp"
-
 #pragma once
 
-#include <unordered_map>
-#include "allocator.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
 #include "types.hpp"
 
-ObjString* getOrIntern(String value);
+// Open-addressing set of strings, probed linearly from each string's cached
+// hash. The table does not own its strings. Entries whose string was not
+// marked by the last trace are dropped by removeUnmarked, which the heap
+// calls before it frees them.
+class WeakStringTable {
+ private:
+  std::vector<ObjString*> slots;
+  std::size_t count = 0;
+
+ public:
+  ObjString* find(std::string_view chars, std::size_t hash) const;
+  void add(ObjString* string);
+  void remove(ObjString* string);
+  void removeUnmarked();
+  // Forgets every entry; the strings themselves are not touched.
+  void clear();
+
+  std::size_t size() const {
+    return count;
+  }
+};
+
+// A string set split into shards. Lookups of strings that are already
+// interned take no lock: slots are published with release stores and slot
+// arrays outgrown by a shard are kept until clear(), so a reader racing with
+// an insertion or a resize at worst misses and retries under the shard's lock.
+class ConcurrentStringTable {
+ private:
+  static constexpr std::size_t SHARD_BITS = 4;
+
+  struct Slots {
+    std::size_t capacity;
+    std::unique_ptr<std::atomic<ObjString*>[]> entries;
+  };
+
+  struct alignas(64) Shard {
+    std::atomic<Slots*> slots{nullptr};
+    mutable std::mutex mutex;
+    std::size_t count = 0;
+    std::vector<std::unique_ptr<Slots>> arrays;
+  };
+
+  std::array<Shard, std::size_t{1} << SHARD_BITS> shards;
+
+  static std::size_t shardOf(std::size_t hash);
+  static ObjString* find(const Slots* slots, std::string_view chars,
+                         std::size_t hash);
+  static void grow(Shard& shard);
+
+ public:
+  ConcurrentStringTable() = default;
+  ~ConcurrentStringTable();
+
+  ObjString* find(std::string_view chars, std::size_t hash) const;
+  ObjString* intern(std::string_view chars);
+  void clear();
+  std::size_t size() const;
+};
+
+// Interned strings live until clearInternedStrings, which must not run while
+// any thread still uses them. Every other function here is thread-safe.
 ObjString* getOrIntern(std::string_view value);
 ObjString* getOrIntern(const char* value);
+// Returns the interned string equal to `value`, or null, without interning.
+ObjString* findInterned(std::string_view value, std::size_t hash);
 void clearInternedStrings();
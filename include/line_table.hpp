@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Maps code offsets to source lines. Stores one entry per run of bytes on
+// the same line, sorted by offset, so lookups are a binary search.
+class LineTable {
+ public:
+  struct LineStart {
+    uint32_t offset;
+    uint32_t line;
+  };
+
+ private:
+  std::vector<LineStart> starts;
+
+ public:
+  // Records that the byte at `offset` (always the next byte of the chunk)
+  // belongs to `line`.
+  void add(std::size_t offset, uint32_t line);
+  // Drops the runs of bytes at or after `count`.
+  void truncate(std::size_t count);
+  void clear();
+  void swap(LineTable& other);
+  uint32_t getLine(std::size_t offset) const;
+  std::size_t size() const;
+
+  // Serialization hook: every run as the LEB128 varint of its offset delta
+  // followed by the zigzag varint of its line delta.
+  void encode(std::vector<uint8_t>& out) const;
+  static std::optional<LineTable> decode(const uint8_t* bytes,
+                                         std::size_t length);
+};
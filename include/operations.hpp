@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+
+#include "heap.hpp"
+#include "interned_strings.hpp"
+#include "types.hpp"
+
+// Value semantics shared by the VM and the compiler's constant folder, so a
+// folded expression behaves exactly like the instructions it replaces.
+// Strings made by an operation are allocated in `heap` when one is given
+// (at runtime) and interned otherwise (at compile time). Operands must not
+// be needed after the result is allocated: the allocation may collect.
+
+struct OperationResult {
+  Type value;
+  const char* error = nullptr;
+};
+
+String toString(const Type& value);
+Type makeString(std::string_view chars, Heap* heap);
+bool valuesEqual(const Type& a, const Type& b);
+OperationResult negate(const Type& value);
+OperationResult logicalNot(const Type& value);
+OperationResult coerce(const Type& value, StaticType type);
+Type concatenateStrings(const Type& a, const Type& b, Heap* heap = nullptr);
+
+// Int arithmetic wraps around in two's complement: results that do not fit,
+// like INT32_MAX + 1 or INT32_MIN / -1, never overflow.
+inline int32_t negateInt(int32_t value) {
+  return static_cast<int32_t>(0u - static_cast<uint32_t>(value));
+}
+
+// `b` must not be zero for a division.
+template <typename Op>
+auto intOperation(Op op, int32_t a, int32_t b) {
+  if constexpr (std::is_same_v<Op, std::divides<>>) {
+    return b == -1 ? negateInt(a) : a / b;
+  } else if constexpr (std::is_same_v<Op, std::plus<>> ||
+                       std::is_same_v<Op, std::minus<>> ||
+                       std::is_same_v<Op, std::multiplies<>>) {
+    return static_cast<int32_t>(
+        op(static_cast<uint32_t>(a), static_cast<uint32_t>(b)));
+  } else {
+    return op(a, b);
+  }
+}
+
+template <typename Op>
+OperationResult binaryOperation(Op op, const Type& a, const Type& b,
+                                Heap* heap = nullptr) {
+  if (isInt(a) && isInt(b)) {
+    if constexpr (std::is_same_v<Op, std::divides<>>) {
+      if (asInt(b) == 0) {
+        return {Type(), "Division by zero."};
+      }
+    }
+    return {intOperation(op, asInt(a), asInt(b))};
+  } else if (isNumber(a) && isNumber(b)) {
+    return {op(asNumber(a), asNumber(b))};
+  } else if (isObject(a) || isObject(b)) {
+    String lhsStr = toString(a);
+    String rhsStr = toString(b);
+
+    String result(lhsStr.begin(), lhsStr.end(), Allocator<char>());
+    result.append(rhsStr.begin(), rhsStr.end());
+
+    return {makeString(result, heap)};
+  }
+
+  return {Type(), "Operator plus is not supported for this type."};
+}
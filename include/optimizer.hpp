@@ -0,0 +1,7 @@
+#pragma once
+
+#include "bytecode.hpp"
+
+// Peephole pass over a finished chunk: fuses common instruction sequences
+// into superinstructions and drops dead value loads.
+void optimizeBytecode(Bytecode& bytecode);
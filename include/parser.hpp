@@ -1,11 +1,13 @@
 #pragma once
 
-#include <functional>
+#include <array>
 #include <memory>
+#include <optional>
 #include <string_view>
-#include <unordered_map>
+#include <vector>
 
 #include "bytecode.hpp"
+#include "globals.hpp"
 #include "interpreter_error.hpp"
 #include "token.hpp"
 #include "tokenizer.hpp"
@@ -26,7 +28,7 @@ enum class Precedence {
 
 class Parser;
 
-using ParseFn = std::function<void()>;
+using ParseFn = void (Parser::*)();
 
 struct ParseRule {
   ParseFn prefix;
@@ -45,11 +47,27 @@ class ParseError : public InterpreterError {
 class Parser {
  private:
   static constexpr uint16_t MAX_CONSTANT_POOL_ADDRESS_LENGTH = 256;
+
+  // A value load that currently ends the chunk; operands of an operator that
+  // are both such loads get folded into a single constant.
+  struct FoldableConstant {
+    std::size_t start;
+    std::size_t end;
+    Type value;
+  };
+
   std::shared_ptr<Bytecode> compilingBytecode;
-  std::unique_ptr<Tokenizer> tokenizer;
-  std::unique_ptr<Token> current;
-  std::unique_ptr<Token> previous;
+  std::shared_ptr<GlobalTable> globals;
+  TokenBuffer tokens;
+  std::size_t cursor = 0;
+  std::size_t current = 0;
+  std::size_t previous = 0;
   bool errored = false;
+  bool canAssign = false;
+  bool optimize = true;
+  StaticType lastType = StaticType::UNKNOWN;
+  std::vector<std::size_t> declaredSlots;
+  std::optional<FoldableConstant> lastConstant;
 
   void parseDecl();
   void parseVarDecl();
@@ -64,7 +82,7 @@ class Parser {
   void parseLiteral();
 
   void var();
-  void namedVar(const std::unique_ptr<Token>& token);
+  void namedVar(std::size_t token);
 
   void next();
   bool match(TokenType type);
@@ -72,35 +90,47 @@ class Parser {
   bool checkPrev(TokenType type);
   bool isVarDecl();
   std::size_t parseVar(std::string_view errorMessage);
-  std::size_t identifierConst(const std::unique_ptr<Token>& token);
-  void defineVar(std::size_t globalAddress);
+  std::size_t resolveGlobal(std::size_t token);
+  void defineVar(std::size_t globalSlot);
+  void declareGlobal(std::size_t slot, StaticType type);
+  void checkStore(std::size_t slot);
 
   void consume(TokenType type, std::string_view message);
+  void consumeStmtEnd(std::string_view message);
   void synchronize();
 
   bool hadError();
   void errorAtCurrent(std::string_view message);
   void error(std::string_view message);
-  void errorAt(const Token* token, std::string_view message);
+  void errorAt(std::size_t token, std::string_view message);
 
   void emitByte(OpCode byte);
   void emitByte(uint8_t byte);
   void emitByte(std::size_t byte);
   void emitVariableByte(OpCode shortCode, OpCode longCode, std::size_t address);
   void emitConstant(const Type& value);
+  void emitValue(const Type& value);
   void emitReturn();
-  void emitDefaultVarValue();
+  void emitDefaultVarValue(TokenType declType);
+
+  std::optional<FoldableConstant> trailingConstant();
+  bool foldBinary(TokenType opType, const FoldableConstant& lhs);
+  bool foldUnary(TokenType opType);
 
   void endParse();
   std::shared_ptr<Bytecode> compilingCode();
 
   void parsePrecedence(Precedence precedence);
-  const ParseRule& getRule(TokenType type);
-  void initializeRules();
+  static const ParseRule& getRule(TokenType type);
 
-  std::unordered_map<TokenType, ParseRule> rules;
+  // Indexed by TokenType.
+  static const std::array<ParseRule,
+                          static_cast<std::size_t>(TokenType::TOKEN_COUNT)>
+      rules;
 
  public:
   Parser();
+  explicit Parser(std::shared_ptr<GlobalTable> globals);
+  void setOptimize(bool enabled);
   bool parse(std::string_view sourceCode, std::shared_ptr<Bytecode> bytecode);
 };
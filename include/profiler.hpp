@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "bytecode.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Execution profile filled in by the VM's profiling dispatch loop: counts
+// and time per opcode, and executions per source line. Time is measured in
+// TSC ticks where available and in steady-clock nanoseconds otherwise.
+class Profiler {
+ private:
+  struct OpCodeStats {
+    uint64_t count = 0;
+    uint64_t ticks = 0;
+  };
+
+  std::array<OpCodeStats, static_cast<std::size_t>(OpCode::OPCODE_COUNT)>
+      opCodes{};
+  // Executions per offset of the running chunk; folded into `lineCounts`
+  // when the run ends so the hot path never looks up a line.
+  std::vector<uint64_t> offsetCounts;
+  std::unordered_map<uint32_t, uint64_t> lineCounts;
+  uint8_t currentOpCode = 0;
+  uint64_t currentStart = 0;
+  bool inInstruction = false;
+
+ public:
+  static inline uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+  }
+
+  static const char* timeUnit();
+
+  void startRun(Bytecode& bytecode);
+  void finishRun(Bytecode& bytecode);
+
+  // Called before every instruction; the time since the previous call is
+  // charged to the previous instruction.
+  inline void countInstruction(uint8_t opCode, std::size_t offset) {
+    uint64_t time = now();
+    if (inInstruction) {
+      opCodes[currentOpCode].ticks += time - currentStart;
+    }
+    opCodes[opCode].count++;
+    offsetCounts[offset]++;
+    currentOpCode = opCode;
+    currentStart = time;
+    inInstruction = true;
+  }
+
+  uint64_t getCount(OpCode opCode) const;
+  uint64_t getLineCount(uint32_t line) const;
+  void report(std::ostream& out, std::size_t maxLines = 20) const;
+};
@@ -1,7 +1,7 @@
 #pragma once
 
 #include <optional>
-#include <unordered_map>
+#include <string_view>
 
 #include "types.hpp"
 
@@ -63,9 +63,6 @@ enum class TokenType {
 };
 
 class Token {
- private:
-  static std::unordered_map<std::string, TokenType> keywords;
-
  public:
   const TokenType type;
   std::string_view lexeme;
@@ -75,5 +72,7 @@ class Token {
   Token(int line, TokenType type, std::string_view lexeme,
         std::optional<Type> literal = std::nullopt);
 
+  // Returns a keyword token if `lexeme` is a keyword, an identifier token
+  // otherwise.
   static Token lookup(std::string_view lexeme, int line);
 };
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <cstdint>
 #include <sstream>
+#include <string>
 #include <string_view>
+#include <vector>
 
 #include "interpreter_error.hpp"
 #include "token.hpp"
@@ -15,6 +18,57 @@ class ScanError : public InterpreterError {
   }
 };
 
+// A token as stored in a TokenBuffer. The lexeme is the source range
+// [offset, offset + length); `extra` indexes the buffer's literals for
+// STRING, INTEGER and DOUBLE tokens and its error messages for ERROR tokens.
+struct PackedToken {
+  uint32_t offset;
+  uint32_t length;
+  uint32_t line;
+  uint32_t extra;
+  TokenType type;
+};
+
+// The tokens of a whole source, filled by Tokenizer::scanAll. Tokens are
+// addressed by index, so any of them can be looked at without rescanning,
+// and clearing keeps the storage for the next source.
+class TokenBuffer {
+ private:
+  std::string_view source;
+  std::vector<PackedToken> tokens;
+  std::vector<Type> literals;
+  std::vector<std::string> errors;
+
+  friend class Tokenizer;
+
+ public:
+  void clear() {
+    tokens.clear();
+    literals.clear();
+    errors.clear();
+  }
+
+  std::size_t size() const {
+    return tokens.size();
+  }
+
+  const PackedToken& operator[](std::size_t index) const {
+    return tokens[index];
+  }
+
+  std::string_view lexeme(std::size_t index) const {
+    return source.substr(tokens[index].offset, tokens[index].length);
+  }
+
+  const Type& literal(std::size_t index) const {
+    return literals[tokens[index].extra];
+  }
+
+  const std::string& error(std::size_t index) const {
+    return errors[tokens[index].extra];
+  }
+};
+
 class Tokenizer {
  private:
   std::string_view source;
@@ -29,8 +83,9 @@ class Tokenizer {
   Token makeToken(TokenType type);
   Token makeToken(std::size_t line, TokenType type, std::string_view lexeme);
   Token makeToken(TokenType type, std::string_view lexeme, const Type& literal);
-  Token errorToken(const std::string& msg);
+  Token errorToken(std::string_view msg);
   void skipWhitespace();
+  void skipBlockComment();
   bool shouldInsertSemicolon();
   Token string();
   Token number();
@@ -46,4 +101,8 @@ class Tokenizer {
   }
 
   Token scanToken();
+
+  // Scans the rest of the source into `buffer`, replacing its contents. The
+  // last token is always TEOF; scan errors become ERROR tokens.
+  void scanAll(TokenBuffer& buffer);
 };
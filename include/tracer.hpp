@@ -0,0 +1,68 @@
+#pragma once
+
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Destination of the VM's execution trace. Output is collected in a large
+// buffer and only reaches the underlying stream when the buffer fills or on
+// flush(), so tracing does not pay for a write per instruction.
+class Tracer {
+ public:
+  enum Flag : unsigned {
+    OPS = 1 << 0,    // every executed instruction
+    STACK = 1 << 1,  // the operand stack before every instruction
+    CODE = 1 << 2,   // a disassembly of each chunk before it runs
+    ALL = OPS | STACK | CODE,
+  };
+
+  // Parses a comma separated list such as "ops,stack"; returns nullopt on
+  // an unknown name.
+  static std::optional<unsigned> parseFlags(std::string_view list);
+
+  Tracer(unsigned flags, std::ostream& target);
+  // Returns nullptr if `path` cannot be opened for writing.
+  static std::unique_ptr<Tracer> toFile(unsigned flags,
+                                        const std::string& path);
+  ~Tracer();
+
+  Tracer(const Tracer&) = delete;
+  Tracer& operator=(const Tracer&) = delete;
+
+  inline bool has(Flag flag) const {
+    return (flags & flag) != 0;
+  }
+
+  inline std::ostream& out() {
+    return stream;
+  }
+
+  void flush();
+
+ private:
+  class Buffer : public std::streambuf {
+   private:
+    static constexpr std::size_t SIZE = 64 * 1024;
+    std::streambuf* target;
+    std::vector<char> data;
+
+   public:
+    explicit Buffer(std::streambuf* target);
+
+   protected:
+    int_type overflow(int_type ch) override;
+    int sync() override;
+  };
+
+  Tracer(unsigned flags, std::unique_ptr<std::ofstream> file);
+
+  unsigned flags;
+  std::unique_ptr<std::ofstream> file;
+  Buffer buffer;
+  std::ostream stream;
+};
@@ -1,6 +1,8 @@
 #pragma once
 
-#include <variant>
+#include <bit>
+#include <cstdint>
+#include <iostream>
 
 #include "dynamic_types.hpp"
 
@@ -10,34 +12,113 @@ struct Null {
   }
 };
 
+enum class ValueType : uint8_t { NUL, INT, DOUBLE, BOOL, OBJECT };
+
+// Type of a value as far as the compiler can prove it. Also used as the
+// declared type of a global; UNKNOWN means any value (`let`).
+enum class StaticType : uint8_t { UNKNOWN, NUL, INT, DOUBLE, BOOL, STRING };
+
+// NaN-boxed value. Doubles are stored as-is, every other type is encoded in
+// the payload of a quiet NaN:
+//
+//   null/bool  0 11111111111 11 00 ... 0000 00xx   (QNAN | 1..3)
+//   int32      0 11111111111 11 01 ... [32-bit payload]
+//   Object*    1 11111111111 11 00 ... [48-bit pointer]
+class Type {
+ public:
+  static constexpr uint64_t SIGN_BIT = 0x8000000000000000;
+  static constexpr uint64_t QNAN = 0x7ffc000000000000;
+  static constexpr uint64_t TAG_MASK = SIGN_BIT | QNAN | 0x0003000000000000;
+  static constexpr uint64_t INT_TAG = QNAN | 0x0001000000000000;
+  static constexpr uint64_t OBJECT_TAG = SIGN_BIT | QNAN;
+  static constexpr uint64_t NULL_VALUE = QNAN | 1;
+  static constexpr uint64_t FALSE_VALUE = QNAN | 2;
+  static constexpr uint64_t TRUE_VALUE = QNAN | 3;
+  static constexpr uint64_t UNDEFINED_VALUE = QNAN | 4;
+  static constexpr uint64_t CANONICAL_NAN = 0x7ff8000000000000;
+
+  constexpr Type() : bits(NULL_VALUE) {
+  }
+
+  constexpr Type(Null) : bits(NULL_VALUE) {
+  }
+
+  constexpr Type(int32_t value)
+      : bits(INT_TAG | static_cast<uint32_t>(value)) {
+  }
+
+  // NaNs produced by arithmetic are canonicalized so they can never alias a
+  // boxed value.
+  constexpr Type(double value)
+      : bits(value != value ? CANONICAL_NAN : std::bit_cast<uint64_t>(value)) {
+  }
+
+  constexpr Type(bool value) : bits(value ? TRUE_VALUE : FALSE_VALUE) {
+  }
+
+  Type(Object* value)
+      : bits(OBJECT_TAG | static_cast<uint64_t>(
+                              reinterpret_cast<uintptr_t>(value))) {
+  }
+
+  // Marks storage that has never been assigned, e.g. a declared but not yet
+  // defined global. Never produced by the language itself.
+  static constexpr Type undefined() {
+    return fromBits(UNDEFINED_VALUE);
+  }
+
+  static constexpr Type fromBits(uint64_t bits) {
+    Type value;
+    value.bits = bits;
+    return value;
+  }
 
-using Type = std::variant<Null, int32_t, double, bool, Object*>; // TODO check Object maybe causes memory leak (for containers)
+  constexpr uint64_t raw() const {
+    return bits;
+  }
 
-void printValue(const Type& value);
+  friend bool operator==(const Type& lhs, const Type& rhs);
+
+ private:
+  uint64_t bits;
+};
+
+static_assert(sizeof(Type) == 8, "Type must stay NaN-boxed into 8 bytes");
+
+void printValue(const Type& value, std::ostream& out = std::cout);
 bool isObjType(const Type& value, const std::type_info& type);
 
 inline bool isNull(const Type& value) {
-  return std::holds_alternative<Null>(value);
+  return value.raw() == Type::NULL_VALUE;
+}
+
+inline bool isUndefined(const Type& value) {
+  return value.raw() == Type::UNDEFINED_VALUE;
 }
 
 inline bool isInt(const Type& value) {
-  return std::holds_alternative<int32_t>(value);
+  return (value.raw() & Type::TAG_MASK) == Type::INT_TAG;
 }
 
 inline bool isDouble(const Type& value) {
-  return std::holds_alternative<double>(value);
+  return (value.raw() & Type::QNAN) != Type::QNAN;
 }
 
 inline bool isBool(const Type& value) {
-  return std::holds_alternative<bool>(value);
+  return (value.raw() | 1) == Type::TRUE_VALUE;
 }
 
 inline bool isObject(const Type& value) {
-  return std::holds_alternative<Object*>(value);
+  return (value.raw() & Type::OBJECT_TAG) == Type::OBJECT_TAG;
+}
+
+inline bool isNumber(const Type& value) {
+  return isInt(value) || isDouble(value);
 }
 
 inline Object* asObject(const Type& value) {
-  return std::get<Object*>(value);
+  return reinterpret_cast<Object*>(
+      static_cast<uintptr_t>(value.raw() & ~Type::OBJECT_TAG));
 }
 
 inline bool isString(const Type& value) {
@@ -45,19 +126,40 @@ inline bool isString(const Type& value) {
 }
 
 inline int32_t asInt(const Type& value) {
-  return std::get<int32_t>(value);
+  return static_cast<int32_t>(static_cast<uint32_t>(value.raw()));
 }
 
 inline double asDouble(const Type& value) {
-  return std::get<double>(value);
+  return std::bit_cast<double>(value.raw());
+}
+
+inline double asNumber(const Type& value) {
+  return isInt(value) ? static_cast<double>(asInt(value)) : asDouble(value);
 }
 
 inline bool asBool(const Type& value) {
-  return std::get<bool>(value);
+  return value.raw() == Type::TRUE_VALUE;
+}
+
+inline ValueType typeOf(const Type& value) {
+  if (isDouble(value)) return ValueType::DOUBLE;
+  if (isInt(value)) return ValueType::INT;
+  if (isObject(value)) return ValueType::OBJECT;
+  if (isBool(value)) return ValueType::BOOL;
+  return ValueType::NUL;
 }
 
 inline bool isSameType(const Type& value1, const Type& value2) {
-  return value1.index() == value2.index();
+  return typeOf(value1) == typeOf(value2);
+}
+
+inline bool operator==(const Type& lhs, const Type& rhs) {
+  if (isDouble(lhs) && isDouble(rhs)) {
+    return asDouble(lhs) == asDouble(rhs);
+  }
+  return lhs.bits == rhs.bits;
 }
 
-ObjString* asString(const Type& value);
\ No newline at end of file
+ObjString* asString(const Type& value);
+StaticType staticTypeOf(const Type& value);
+const char* staticTypeName(StaticType type);
@@ -1,12 +1,15 @@
 #pragma once
 
-#include <deque>
 #include <memory>
-#include <variant>
 
 #include "bytecode.hpp"
+#include "globals.hpp"
+#include "heap.hpp"
 #include "interned_strings.hpp"
+#include "operations.hpp"
 #include "parser.hpp"
+#include "profiler.hpp"
+#include "tracer.hpp"
 #include "types.hpp"
 
 enum class InterpretResult {
@@ -28,78 +31,180 @@ class VM {
   static constexpr size_t STACK_MAX = 256;
   std::shared_ptr<Bytecode> bytecode;
   uint8_t* ip;
-  std::deque<Type> stack;
-  Parser parser;
-  std::vector<Object*, Allocator<Object*>> objects;
-  std::unordered_map<String, Type> globals;
+  std::vector<Type, Allocator<Type>> stack;
+  Type* stackTop = nullptr;
+  std::shared_ptr<GlobalTable> globals = std::make_shared<GlobalTable>();
+  Type* globalValues = nullptr;
+  // Remembered set of the global slots written with a young object since
+  // the last collection, with a card per slot so each is listed once.
+  std::vector<uint32_t, Allocator<uint32_t>> rememberedGlobals;
+  std::vector<uint8_t, Allocator<uint8_t>> globalCards;
+  Parser parser{globals};
+  Heap heap;
+  std::unique_ptr<Profiler> profiler;
+  std::unique_ptr<Tracer> tracer;
+
+  // Instrumentation is compiled into separate instantiations of the
+  // dispatch loop, one per combination of modes, so the plain loop carries
+  // none of it.
+  enum RunMode : unsigned { PLAIN = 0, PROFILE = 1 << 0, TRACE = 1 << 1 };
+
+  template <unsigned mode>
+  InterpretResult execute();
+
+  inline Type pop() {
+    return *--stackTop;
+  }
+
+  inline void push(Type value) {
+    *stackTop++ = value;
+  }
+
+  inline Type peek(std::size_t distance) const {
+    return stackTop[-1 - static_cast<std::ptrdiff_t>(distance)];
+  }
 
-  Type pop();
-  void push(Type value);
-  Type peek(std::size_t distance) const;
+  void prepareStack();
+  void resetStack();
 
-  String checkVarExistsAndGetName(Type constName);
+  [[noreturn]] void undefinedVariable(std::size_t slot);
 
+  void traceInstruction();
   std::size_t currentInstructionAddress();
   uint32_t getCurrentLine();
-  String toString(const Type& value);
 
-  template <typename T, typename... Args>
-  T* allocateObject(Args&&... args) {
-    T* obj = allocateAndConstruct<T>(std::forward<Args>(args)...);
-    objects.push_back(obj);
-    return obj;
-  }
+  void markRoots();
 
   template <typename Op>
   void binaryOp(Op op) {
     Type b = pop();
     Type a = pop();
+    pushBinary(op, a, b);
+  }
+
+  template <typename Op>
+  void pushBinary(Op op, const Type& a, const Type& b) {
+    OperationResult result = binaryOperation(op, a, b, &heap);
+    if (result.error) {
+      throw RuntimeError(getCurrentLine(), result.error);
+    }
+    push(result.value);
+  }
+
+  // Operands of the type-specialized opcodes were proven by the compiler,
+  // or by the guard of a quickened one.
+  template <typename Op>
+  void intBinaryOp(Op op) {
+    if constexpr (std::is_same_v<Op, std::divides<>>) {
+      if (asInt(peek(0)) == 0) {
+        throw RuntimeError(getCurrentLine(), "Division by zero.");
+      }
+    }
+    int32_t b = asInt(pop());
+    int32_t a = asInt(pop());
+    push(intOperation(op, a, b));
+  }
+
+  template <typename Op>
+  void doubleBinaryOp(Op op) {
+    double b = asDouble(pop());
+    double a = asDouble(pop());
+    push(op(a, b));
+  }
 
-    std::visit(
-        [&](auto&& lhs, auto&& rhs) -> void {
-          using LHS = std::decay_t<decltype(lhs)>;
-          using RHS = std::decay_t<decltype(rhs)>;
-
-          if constexpr ((std::is_same_v<LHS, int32_t> &&
-                         std::is_same_v<RHS, int32_t>) ||
-                        (std::is_same_v<LHS, double> &&
-                         std::is_same_v<RHS, double>)) {
-            push(op(lhs, rhs));
-          } else if constexpr ((std::is_same_v<LHS, int32_t> &&
-                                std::is_same_v<RHS, double>) ||
-                               (std::is_same_v<LHS, double> &&
-                                std::is_same_v<RHS, int32_t>)) {
-            push(op(static_cast<double>(lhs), static_cast<double>(rhs)));
-          } else if constexpr (std::is_same_v<LHS, Object*> ||
-                               std::is_same_v<RHS, Object*>) {
-            String lhsStr = toString(lhs);
-            String rhsStr = toString(rhs);
-
-            String result(lhsStr.begin(), lhsStr.end(), Allocator<char>());
-            result.append(rhsStr.begin(), rhsStr.end());
-
-            auto interned = getOrIntern(result);
-            push(interned);
-          } else {
-            throw RuntimeError(bytecode->getLine(currentInstructionAddress()),
-                               "Operator plus is not supported for this type.");
-          }
-        },
-        a, b);
+  // Rewrites the opcode of the instruction at `instruction` in place.
+  inline void quicken(uint8_t* instruction, OpCode opCode) {
+    *instruction = static_cast<uint8_t>(opCode);
+  }
+
+  void quickenBinary(OpCode generic);
+
+  // Quickened int/double forms run the specialized operation while the
+  // operands keep the types seen when quickening. Otherwise the instruction
+  // is rewritten back to the generic opcode, which quickens again on the
+  // types it sees next.
+  template <typename Op>
+  void guardedIntOp(Op op, OpCode generic) {
+    if (isInt(peek(0)) && isInt(peek(1))) {
+      intBinaryOp(op);
+    } else {
+      quicken(ip - 1, generic);
+      binaryOp(op);
+    }
+  }
+
+  template <typename Op>
+  void guardedDoubleOp(Op op, OpCode generic) {
+    if (isDouble(peek(0)) && isDouble(peek(1))) {
+      doubleBinaryOp(op);
+    } else {
+      quicken(ip - 1, generic);
+      binaryOp(op);
+    }
   }
 
   Type readConstantLong();
+  std::size_t readSlotLong();
 
   inline uint8_t readByte() {
     return *ip++;
   }
 
   inline Type readConstant() {
-    return bytecode->getConstant(readByte());
+    return bytecode->readConstant(readByte());
+  }
+
+  inline Type& readGlobal() {
+    return globalValues[readByte()];
+  }
+
+  inline Type& readGlobalLong() {
+    return globalValues[readSlotLong()];
+  }
+
+  // Every store into a global goes through the heap's write barriers:
+  // young values are remembered for minor collections, old ones are shaded
+  // while an incremental cycle is marking.
+  inline void storeGlobal(Type& global, Type value) {
+    global = value;
+    if (heap.isYoung(value)) {
+      rememberGlobal(static_cast<std::size_t>(&global - globalValues));
+    } else {
+      heap.writeBarrier(value);
+    }
+  }
+
+  void rememberGlobal(std::size_t slot);
+
+  inline const Type& readDefinedGlobal() {
+    const Type& global = readGlobal();
+    if (isUndefined(global)) undefinedVariable(&global - globalValues);
+    return global;
   }
 
  public:
-  ~VM();
+  VM();
   InterpretResult interpret(const std::string& sourceCode);
+  // Runs a chunk returned by compile(); chunks may be run more than once.
+  InterpretResult interpret(std::shared_ptr<Bytecode> chunk);
+  std::shared_ptr<Bytecode> compile(const std::string& sourceCode);
+  // Loads a precompiled bytecode file; returns nullptr if it is invalid.
+  std::shared_ptr<Bytecode> load(const std::string& path);
   InterpretResult run();
+  void setOptimize(bool enabled);
+  // Returns false if the profiler was compiled out (ONOL_PROFILER=OFF).
+  bool enableProfiling();
+  const Profiler* getProfiler() const;
+  // Traces every following run; nullptr turns tracing off.
+  void setTracer(std::unique_ptr<Tracer> newTracer);
+  // Strings in the returned value stay valid until the next run or
+  // collection.
+  std::optional<Type> getGlobal(std::string_view name);
+  // Frees strings no longer reachable from the globals.
+  void collectGarbage();
+  // Collects garbage before every allocation.
+  void setStressGC(bool enabled);
+  // Collects the old generation in slices interleaved with execution.
+  void setIncrementalGC(bool enabled, Heap::SliceBudget budget = {});
+  const Heap& getHeap() const;
 };
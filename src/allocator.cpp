@@ -1,6 +1,7 @@
 #include "allocator.hpp"
 
 #include <cstdlib>
+#include <new>
 
 void *reallocate(void *pointer, [[maybe_unused]] size_t oldSize,
                  size_t newSize) {
@@ -12,3 +13,16 @@ void *reallocate(void *pointer, [[maybe_unused]] size_t oldSize,
   return std::realloc(pointer, newSize);
 }
 
+
+BumpAllocator::BumpAllocator(std::size_t capacity) {
+  start = static_cast<char *>(reallocate(nullptr, 0, capacity));
+  if (!start) {
+    throw std::bad_alloc();
+  }
+  next = start;
+  end = start + capacity;
+}
+
+BumpAllocator::~BumpAllocator() {
+  reallocate(start, capacity(), 0);
+}
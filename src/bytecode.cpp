@@ -1,17 +1,233 @@
 #include "bytecode.hpp"
 
+#include <iterator>
 #include <memory>
+#include <optional>
+#include <string>
+#include <vector>
 
-void Bytecode::addLine(uint32_t line) {
-  if (lines.size() > 0 && lines.back()->line == line) {
-    return;
+#include "interned_strings.hpp"
+
+static constexpr const char* OPCODE_NAMES[] = {
+    "CONSTANT", "CONSTANT_LONG", "DEFINE_GLOBAL", "DEFINE_GLOBAL_LONG",
+    "GET_GLOBAL", "GET_GLOBAL_LONG", "SET_GLOBAL", "SET_GLOBAL_LONG", "NUL",
+    "TRUE", "FALSE", "ADD", "SUBTRACT", "MULTIPLY", "DIVIDE", "NEGATE", "NOT",
+    "EQUAL", "GREATER", "LESS", "GREATER_EQUAL", "LESS_EQUAL", "NOT_EQUAL",
+    "POP", "RETURN", "ADD_INT", "SUBTRACT_INT", "MULTIPLY_INT", "DIVIDE_INT",
+    "ADD_DOUBLE", "SUBTRACT_DOUBLE", "MULTIPLY_DOUBLE", "DIVIDE_DOUBLE",
+    "GREATER_INT", "LESS_INT", "GREATER_EQUAL_INT", "LESS_EQUAL_INT",
+    "GREATER_DOUBLE", "LESS_DOUBLE", "GREATER_EQUAL_DOUBLE",
+    "LESS_EQUAL_DOUBLE", "NEGATE_INT", "NEGATE_DOUBLE", "CONCAT_STR", "COERCE",
+    "ADD_CONSTANT", "SUBTRACT_CONSTANT", "MULTIPLY_CONSTANT", "DIVIDE_CONSTANT",
+    "ADD_GLOBALS", "SUBTRACT_GLOBALS", "MULTIPLY_GLOBALS", "DIVIDE_GLOBALS",
+    "SET_GLOBAL_POP", "ADD_INT_QUICK", "SUBTRACT_INT_QUICK",
+    "MULTIPLY_INT_QUICK", "DIVIDE_INT_QUICK", "ADD_DOUBLE_QUICK",
+    "SUBTRACT_DOUBLE_QUICK", "MULTIPLY_DOUBLE_QUICK", "DIVIDE_DOUBLE_QUICK",
+    "GREATER_INT_QUICK", "LESS_INT_QUICK", "GREATER_EQUAL_INT_QUICK",
+    "LESS_EQUAL_INT_QUICK", "GREATER_DOUBLE_QUICK", "LESS_DOUBLE_QUICK",
+    "GREATER_EQUAL_DOUBLE_QUICK", "LESS_EQUAL_DOUBLE_QUICK", "CONCAT_STR_QUICK",
+    "GET_GLOBAL_QUICK", "GET_GLOBAL_LONG_QUICK",
+};
+static_assert(std::size(OPCODE_NAMES) ==
+                  static_cast<std::size_t>(OpCode::OPCODE_COUNT),
+              "OPCODE_NAMES must list every OpCode in declaration order");
+
+const char* opCodeName(OpCode opCode) {
+  if (opCode >= OpCode::OPCODE_COUNT) {
+    return "UNKNOWN";
+  }
+  return OPCODE_NAMES[static_cast<std::size_t>(opCode)];
+}
+
+std::size_t instructionLength(OpCode opCode) {
+  switch (opCode) {
+    case OpCode::CONSTANT:
+    case OpCode::DEFINE_GLOBAL:
+    case OpCode::GET_GLOBAL:
+    case OpCode::SET_GLOBAL:
+    case OpCode::ADD_CONSTANT:
+    case OpCode::SUBTRACT_CONSTANT:
+    case OpCode::MULTIPLY_CONSTANT:
+    case OpCode::DIVIDE_CONSTANT:
+    case OpCode::SET_GLOBAL_POP:
+    case OpCode::COERCE:
+    case OpCode::GET_GLOBAL_QUICK:
+      return 2;
+    case OpCode::ADD_GLOBALS:
+    case OpCode::SUBTRACT_GLOBALS:
+    case OpCode::MULTIPLY_GLOBALS:
+    case OpCode::DIVIDE_GLOBALS:
+      return 3;
+    case OpCode::CONSTANT_LONG:
+    case OpCode::DEFINE_GLOBAL_LONG:
+    case OpCode::GET_GLOBAL_LONG:
+    case OpCode::SET_GLOBAL_LONG:
+    case OpCode::GET_GLOBAL_LONG_QUICK:
+      return 4;
+    default:
+      return 1;
+  }
+}
+
+int stackEffect(OpCode opCode) {
+  switch (opCode) {
+    case OpCode::CONSTANT:
+    case OpCode::CONSTANT_LONG:
+    case OpCode::GET_GLOBAL:
+    case OpCode::GET_GLOBAL_LONG:
+    case OpCode::NUL:
+    case OpCode::TRUE:
+    case OpCode::FALSE:
+    case OpCode::ADD_GLOBALS:
+    case OpCode::SUBTRACT_GLOBALS:
+    case OpCode::MULTIPLY_GLOBALS:
+    case OpCode::DIVIDE_GLOBALS:
+    case OpCode::GET_GLOBAL_QUICK:
+    case OpCode::GET_GLOBAL_LONG_QUICK:
+      return 1;
+    case OpCode::DEFINE_GLOBAL:
+    case OpCode::DEFINE_GLOBAL_LONG:
+    case OpCode::ADD:
+    case OpCode::SUBTRACT:
+    case OpCode::MULTIPLY:
+    case OpCode::DIVIDE:
+    case OpCode::EQUAL:
+    case OpCode::GREATER:
+    case OpCode::LESS:
+    case OpCode::GREATER_EQUAL:
+    case OpCode::LESS_EQUAL:
+    case OpCode::NOT_EQUAL:
+    case OpCode::POP:
+    case OpCode::SET_GLOBAL_POP:
+    case OpCode::ADD_INT:
+    case OpCode::SUBTRACT_INT:
+    case OpCode::MULTIPLY_INT:
+    case OpCode::DIVIDE_INT:
+    case OpCode::ADD_DOUBLE:
+    case OpCode::SUBTRACT_DOUBLE:
+    case OpCode::MULTIPLY_DOUBLE:
+    case OpCode::DIVIDE_DOUBLE:
+    case OpCode::GREATER_INT:
+    case OpCode::LESS_INT:
+    case OpCode::GREATER_EQUAL_INT:
+    case OpCode::LESS_EQUAL_INT:
+    case OpCode::GREATER_DOUBLE:
+    case OpCode::LESS_DOUBLE:
+    case OpCode::GREATER_EQUAL_DOUBLE:
+    case OpCode::LESS_EQUAL_DOUBLE:
+    case OpCode::CONCAT_STR:
+    case OpCode::ADD_INT_QUICK:
+    case OpCode::SUBTRACT_INT_QUICK:
+    case OpCode::MULTIPLY_INT_QUICK:
+    case OpCode::DIVIDE_INT_QUICK:
+    case OpCode::ADD_DOUBLE_QUICK:
+    case OpCode::SUBTRACT_DOUBLE_QUICK:
+    case OpCode::MULTIPLY_DOUBLE_QUICK:
+    case OpCode::DIVIDE_DOUBLE_QUICK:
+    case OpCode::GREATER_INT_QUICK:
+    case OpCode::LESS_INT_QUICK:
+    case OpCode::GREATER_EQUAL_INT_QUICK:
+    case OpCode::LESS_EQUAL_INT_QUICK:
+    case OpCode::GREATER_DOUBLE_QUICK:
+    case OpCode::LESS_DOUBLE_QUICK:
+    case OpCode::GREATER_EQUAL_DOUBLE_QUICK:
+    case OpCode::LESS_EQUAL_DOUBLE_QUICK:
+    case OpCode::CONCAT_STR_QUICK:
+      return -1;
+    default:
+      return 0;
+  }
+}
+
+// Operands an instruction pops or reads in place before it runs.
+static std::size_t stackInputs(OpCode opCode) {
+  switch (opCode) {
+    case OpCode::DEFINE_GLOBAL:
+    case OpCode::DEFINE_GLOBAL_LONG:
+    case OpCode::SET_GLOBAL:
+    case OpCode::SET_GLOBAL_LONG:
+    case OpCode::SET_GLOBAL_POP:
+    case OpCode::NEGATE:
+    case OpCode::NOT:
+    case OpCode::POP:
+    case OpCode::NEGATE_INT:
+    case OpCode::NEGATE_DOUBLE:
+    case OpCode::COERCE:
+    case OpCode::ADD_CONSTANT:
+    case OpCode::SUBTRACT_CONSTANT:
+    case OpCode::MULTIPLY_CONSTANT:
+    case OpCode::DIVIDE_CONSTANT:
+      return 1;
+    default:
+      // Every other instruction that shrinks the stack is binary.
+      return stackEffect(opCode) < 0 ? 2 : 0;
   }
+}
+
+static bool isNumeric(StaticType type) {
+  return type == StaticType::INT || type == StaticType::DOUBLE;
+}
+
+// Mirrors binaryOperation: any operation on a string concatenates, numbers
+// are promoted to double unless both operands are ints.
+StaticType binaryResultType(OpCode generic, StaticType a, StaticType b) {
+  bool comparison =
+      generic == OpCode::GREATER || generic == OpCode::GREATER_EQUAL ||
+      generic == OpCode::LESS || generic == OpCode::LESS_EQUAL;
+
+  if (generic == OpCode::EQUAL || generic == OpCode::NOT_EQUAL) {
+    return StaticType::BOOL;
+  } else if (a == StaticType::STRING || b == StaticType::STRING) {
+    return StaticType::STRING;
+  } else if (isNumeric(a) && isNumeric(b)) {
+    if (comparison) {
+      return StaticType::BOOL;
+    }
+    return a == StaticType::INT && b == StaticType::INT ? StaticType::INT
+                                                        : StaticType::DOUBLE;
+  }
+  return StaticType::UNKNOWN;
+}
 
-  std::unique_ptr<LineStart> lineStart = std::make_unique<LineStart>();
-  lineStart->line = line;
-  lineStart->offset = code.size() - 1;
+OpCode genericOpCode(OpCode opCode) {
+  switch (opCode) {
+    case OpCode::ADD_INT_QUICK:
+    case OpCode::ADD_DOUBLE_QUICK:
+    case OpCode::CONCAT_STR_QUICK:
+      return OpCode::ADD;
+    case OpCode::SUBTRACT_INT_QUICK:
+    case OpCode::SUBTRACT_DOUBLE_QUICK:
+      return OpCode::SUBTRACT;
+    case OpCode::MULTIPLY_INT_QUICK:
+    case OpCode::MULTIPLY_DOUBLE_QUICK:
+      return OpCode::MULTIPLY;
+    case OpCode::DIVIDE_INT_QUICK:
+    case OpCode::DIVIDE_DOUBLE_QUICK:
+      return OpCode::DIVIDE;
+    case OpCode::GREATER_INT_QUICK:
+    case OpCode::GREATER_DOUBLE_QUICK:
+      return OpCode::GREATER;
+    case OpCode::LESS_INT_QUICK:
+    case OpCode::LESS_DOUBLE_QUICK:
+      return OpCode::LESS;
+    case OpCode::GREATER_EQUAL_INT_QUICK:
+    case OpCode::GREATER_EQUAL_DOUBLE_QUICK:
+      return OpCode::GREATER_EQUAL;
+    case OpCode::LESS_EQUAL_INT_QUICK:
+    case OpCode::LESS_EQUAL_DOUBLE_QUICK:
+      return OpCode::LESS_EQUAL;
+    case OpCode::GET_GLOBAL_QUICK:
+      return OpCode::GET_GLOBAL;
+    case OpCode::GET_GLOBAL_LONG_QUICK:
+      return OpCode::GET_GLOBAL_LONG;
+    default:
+      return opCode;
+  }
+}
 
-  lines.push_back(std::move(lineStart));
+void Bytecode::addLine(uint32_t line) {
+  lines.add(code.size() - 1, line);
+  depth.reset();
 }
 
 void Bytecode::putOpCode(OpCode byte, uint32_t line) {
@@ -44,47 +260,371 @@ std::size_t Bytecode::putConstant(Type value, uint32_t line) {
 }
 
 std::size_t Bytecode::createConstant(Type value) {
-  constantPool.push_back(value);
-  return constantPool.size() - 1;
+  auto [it, inserted] =
+      constantAddresses.try_emplace(value.raw(), constantPool.size());
+  if (inserted) {
+    constantPool.push_back(value);
+  }
+  return it->second;
+}
+
+void Bytecode::truncate(std::size_t newCount) {
+  code.resize(newCount);
+  lines.truncate(newCount);
+  depth.reset();
+}
+
+void Bytecode::swapCode(Bytecode& other) {
+  code.swap(other.code);
+  lines.swap(other.lines);
+  depth.reset();
+  other.depth.reset();
 }
 
 void Bytecode::free() {
+  depth.reset();
   code.clear();
   code.shrink_to_fit();
+  lines.clear();
+  mappedCode = nullptr;
+  mappedCount = 0;
+  lazyStrings.clear();
+  mapping.reset();
 
   constantPool.clear();
   constantPool.shrink_to_fit();
+  constantAddresses.clear();
 }
 
 OpCode Bytecode::getOpCode(int offset) {
-  return static_cast<OpCode>(code[offset]);
+  return static_cast<OpCode>(codeData()[offset]);
 }
 
 uint8_t Bytecode::getConstantAddress(int offset) {
-  return code[offset];
+  return codeData()[offset];
 }
 
 Type Bytecode::getConstant(int address) {
-  return constantPool[address];
+  Type value = constantPool[address];
+  if (isUndefined(value)) {
+    value = getOrIntern(lazyStrings[address]);
+    constantPool[address] = value;
+  }
+  return value;
+}
+
+void Bytecode::internLazyStrings() {
+  for (std::size_t address = 0; address < lazyStrings.size(); address++) {
+    if (isUndefined(constantPool[address])) {
+      constantPool[address] = getOrIntern(lazyStrings[address]);
+    }
+  }
+  lazyStrings.clear();
 }
 
 uint32_t Bytecode::getLine(std::size_t offset) {
-  if (lines.empty()) {
-    return 0;
+  return lines.getLine(offset);
+}
+
+uint8_t* Bytecode::getCodePointer() {
+  return codeData();
+}
+
+void Bytecode::setGlobals(std::shared_ptr<GlobalTable> table) {
+  globals = std::move(table);
+  depth.reset();
+}
+
+GlobalTable* Bytecode::getGlobals() {
+  return globals.get();
+}
+
+std::size_t Bytecode::count() {
+  return mappedCode ? mappedCount : code.size();
+}
+
+std::size_t Bytecode::constantCount() {
+  return constantPool.size();
+}
+
+const std::vector<Type, Allocator<Type>>& Bytecode::getConstantPool() const {
+  return constantPool;
+}
+
+const LineTable& Bytecode::getLines() {
+  return lines;
+}
+
+void Bytecode::mapCode(std::shared_ptr<void> storage, uint8_t* code,
+                       std::size_t count) {
+  mapping = std::move(storage);
+  depth.reset();
+  mappedCode = code;
+  mappedCount = count;
+}
+
+void Bytecode::appendConstant(Type value) {
+  constantPool.push_back(value);
+  lazyStrings.emplace_back();
+}
+
+void Bytecode::appendLazyString(std::string_view chars) {
+  constantPool.push_back(Type::undefined());
+  lazyStrings.push_back(chars);
+}
+
+void Bytecode::setLines(LineTable table) {
+  lines = std::move(table);
+}
+
+static std::size_t readLongOperand(const uint8_t* operands) {
+  return operands[0] | (operands[1] << 8) | (operands[2] << 16);
+}
+
+StaticType Bytecode::constantType(std::size_t address, std::size_t offset) {
+  if (address >= constantPool.size()) {
+    throw BytecodeError(getLine(offset),
+                        "Constant " + std::to_string(address) +
+                            " out of range at offset " +
+                            std::to_string(offset) + ".");
   }
+  // Strings of a loaded chunk are undefined until first use.
+  Type constant = constantPool[address];
+  return isUndefined(constant) ? StaticType::STRING : staticTypeOf(constant);
+}
+
+StaticType Bytecode::globalType(std::size_t slot, std::size_t offset) {
+  if (!globals) {
+    return StaticType::UNKNOWN;
+  } else if (slot >= globals->count()) {
+    throw BytecodeError(getLine(offset),
+                        "Global slot " + std::to_string(slot) +
+                            " out of range at offset " +
+                            std::to_string(offset) + ".");
+  }
+  return globals->getType(slot);
+}
+
+// The VM does not check stores into typed globals, so their values must be
+// of the declared type.
+void Bytecode::checkStore(std::size_t slot, StaticType type,
+                          std::size_t offset) {
+  StaticType declared = globalType(slot, offset);
+  if (declared != StaticType::UNKNOWN && type != declared) {
+    throw BytecodeError(getLine(offset),
+                        "Store into '" + globals->getName(slot)->toString() +
+                            "' at offset " + std::to_string(offset) +
+                            " is not proven to be " +
+                            staticTypeName(declared) + ".");
+  }
+}
 
-  for (std::size_t i = lines.size(); i > 0; --i) {
-    if (lines[i - 1]->offset <= offset) {
-      return lines[i - 1]->line;
+// Checks the operands of the instruction at `offset`, given the static
+// types of the values it takes from the stack, and returns the type of the
+// value it pushes. The operands of typed opcodes must be proven: the VM
+// trusts them.
+StaticType Bytecode::checkInstruction(OpCode opCode, std::size_t offset,
+                                      const StaticType* inputs) {
+  const uint8_t* operands = codeData() + offset + 1;
+  auto require = [&](StaticType type, std::size_t count) {
+    for (std::size_t i = 0; i < count; i++) {
+      if (inputs[i] != type) {
+        throw BytecodeError(getLine(offset),
+                            std::string("Operands of ") + opCodeName(opCode) +
+                                " at offset " + std::to_string(offset) +
+                                " are not proven to be " +
+                                staticTypeName(type) + ".");
+      }
     }
+  };
+
+  switch (opCode) {
+    case OpCode::CONSTANT:
+      return constantType(operands[0], offset);
+    case OpCode::CONSTANT_LONG:
+      return constantType(readLongOperand(operands), offset);
+    case OpCode::GET_GLOBAL:
+    case OpCode::GET_GLOBAL_QUICK:
+      return globalType(operands[0], offset);
+    case OpCode::GET_GLOBAL_LONG:
+    case OpCode::GET_GLOBAL_LONG_QUICK:
+      return globalType(readLongOperand(operands), offset);
+    case OpCode::DEFINE_GLOBAL:
+    case OpCode::SET_GLOBAL:
+    case OpCode::SET_GLOBAL_POP:
+      checkStore(operands[0], inputs[0], offset);
+      return inputs[0];
+    case OpCode::DEFINE_GLOBAL_LONG:
+    case OpCode::SET_GLOBAL_LONG:
+      checkStore(readLongOperand(operands), inputs[0], offset);
+      return inputs[0];
+    case OpCode::NUL:
+      return StaticType::NUL;
+    case OpCode::TRUE:
+    case OpCode::FALSE:
+    case OpCode::NOT:
+      return StaticType::BOOL;
+    case OpCode::NEGATE:
+      return isNumeric(inputs[0]) ? inputs[0] : StaticType::UNKNOWN;
+
+    case OpCode::ADD:
+    case OpCode::SUBTRACT:
+    case OpCode::MULTIPLY:
+    case OpCode::DIVIDE:
+    case OpCode::EQUAL:
+    case OpCode::GREATER:
+    case OpCode::LESS:
+    case OpCode::GREATER_EQUAL:
+    case OpCode::LESS_EQUAL:
+    case OpCode::NOT_EQUAL:
+    // Quickened forms fall back to the generic opcode when their guard fails.
+    case OpCode::ADD_INT_QUICK:
+    case OpCode::SUBTRACT_INT_QUICK:
+    case OpCode::MULTIPLY_INT_QUICK:
+    case OpCode::DIVIDE_INT_QUICK:
+    case OpCode::ADD_DOUBLE_QUICK:
+    case OpCode::SUBTRACT_DOUBLE_QUICK:
+    case OpCode::MULTIPLY_DOUBLE_QUICK:
+    case OpCode::DIVIDE_DOUBLE_QUICK:
+    case OpCode::GREATER_INT_QUICK:
+    case OpCode::LESS_INT_QUICK:
+    case OpCode::GREATER_EQUAL_INT_QUICK:
+    case OpCode::LESS_EQUAL_INT_QUICK:
+    case OpCode::GREATER_DOUBLE_QUICK:
+    case OpCode::LESS_DOUBLE_QUICK:
+    case OpCode::GREATER_EQUAL_DOUBLE_QUICK:
+    case OpCode::LESS_EQUAL_DOUBLE_QUICK:
+    case OpCode::CONCAT_STR_QUICK:
+      return binaryResultType(genericOpCode(opCode), inputs[0], inputs[1]);
+
+    case OpCode::ADD_INT:
+    case OpCode::SUBTRACT_INT:
+    case OpCode::MULTIPLY_INT:
+    case OpCode::DIVIDE_INT:
+      require(StaticType::INT, 2);
+      return StaticType::INT;
+    case OpCode::GREATER_INT:
+    case OpCode::LESS_INT:
+    case OpCode::GREATER_EQUAL_INT:
+    case OpCode::LESS_EQUAL_INT:
+      require(StaticType::INT, 2);
+      return StaticType::BOOL;
+    case OpCode::ADD_DOUBLE:
+    case OpCode::SUBTRACT_DOUBLE:
+    case OpCode::MULTIPLY_DOUBLE:
+    case OpCode::DIVIDE_DOUBLE:
+      require(StaticType::DOUBLE, 2);
+      return StaticType::DOUBLE;
+    case OpCode::GREATER_DOUBLE:
+    case OpCode::LESS_DOUBLE:
+    case OpCode::GREATER_EQUAL_DOUBLE:
+    case OpCode::LESS_EQUAL_DOUBLE:
+      require(StaticType::DOUBLE, 2);
+      return StaticType::BOOL;
+    case OpCode::NEGATE_INT:
+      require(StaticType::INT, 1);
+      return StaticType::INT;
+    case OpCode::NEGATE_DOUBLE:
+      require(StaticType::DOUBLE, 1);
+      return StaticType::DOUBLE;
+    case OpCode::CONCAT_STR:
+      require(StaticType::STRING, 2);
+      return StaticType::STRING;
+    case OpCode::COERCE: {
+      if (operands[0] > static_cast<uint8_t>(StaticType::STRING)) {
+        throw BytecodeError(getLine(offset),
+                            "Unknown type " + std::to_string(operands[0]) +
+                                " at offset " + std::to_string(offset) + ".");
+      }
+      auto type = static_cast<StaticType>(operands[0]);
+      return type == StaticType::UNKNOWN ? inputs[0] : type;
+    }
+
+    case OpCode::ADD_CONSTANT:
+      return binaryResultType(OpCode::ADD, inputs[0],
+                              constantType(operands[0], offset));
+    case OpCode::SUBTRACT_CONSTANT:
+      return binaryResultType(OpCode::SUBTRACT, inputs[0],
+                              constantType(operands[0], offset));
+    case OpCode::MULTIPLY_CONSTANT:
+      return binaryResultType(OpCode::MULTIPLY, inputs[0],
+                              constantType(operands[0], offset));
+    case OpCode::DIVIDE_CONSTANT:
+      return binaryResultType(OpCode::DIVIDE, inputs[0],
+                              constantType(operands[0], offset));
+    case OpCode::ADD_GLOBALS:
+      return binaryResultType(OpCode::ADD, globalType(operands[0], offset),
+                              globalType(operands[1], offset));
+    case OpCode::SUBTRACT_GLOBALS:
+      return binaryResultType(OpCode::SUBTRACT,
+                              globalType(operands[0], offset),
+                              globalType(operands[1], offset));
+    case OpCode::MULTIPLY_GLOBALS:
+      return binaryResultType(OpCode::MULTIPLY,
+                              globalType(operands[0], offset),
+                              globalType(operands[1], offset));
+    case OpCode::DIVIDE_GLOBALS:
+      return binaryResultType(OpCode::DIVIDE, globalType(operands[0], offset),
+                              globalType(operands[1], offset));
+
+    default:
+      // POP and RETURN push nothing.
+      return StaticType::UNKNOWN;
   }
-  return 0;
 }
 
-uint8_t* Bytecode::getCodePointer() {
-  return code.data();
+const StackDepth& Bytecode::stackDepth() {
+  if (!depth) {
+    depth = computeStackDepth();
+  }
+  return *depth;
 }
 
-std::size_t Bytecode::count() {
-  return code.size();
+StackDepth Bytecode::computeStackDepth() {
+  StackDepth result;
+  // Static types of the values on the operand stack.
+  std::vector<StaticType> types;
+  OpCode last = OpCode::OPCODE_COUNT;
+
+  const uint8_t* bytes = codeData();
+  std::size_t size = count();
+
+  for (std::size_t offset = 0; offset < size;) {
+    if (bytes[offset] >= static_cast<uint8_t>(OpCode::OPCODE_COUNT)) {
+      throw BytecodeError(getLine(offset),
+                          "Unknown opcode " + std::to_string(bytes[offset]) +
+                              " at offset " + std::to_string(offset) + ".");
+    }
+
+    OpCode opCode = getOpCode(offset);
+    if (offset + instructionLength(opCode) > size) {
+      throw BytecodeError(getLine(offset), "Truncated instruction at offset " +
+                                               std::to_string(offset) + ".");
+    }
+
+    std::size_t inputs = stackInputs(opCode);
+    if (types.size() < inputs) {
+      throw BytecodeError(getLine(offset), "Stack underflow at offset " +
+                                               std::to_string(offset) + ".");
+    }
+    StaticType pushed =
+        checkInstruction(opCode, offset, types.data() + types.size() - inputs);
+    types.resize(types.size() - inputs);
+    if (static_cast<int>(inputs) + stackEffect(opCode) > 0) {
+      types.push_back(pushed);
+    }
+
+    if (types.size() > result.max) {
+      result.max = types.size();
+      result.offset = offset;
+    }
+    offset += instructionLength(opCode);
+    last = opCode;
+  }
+
+  if (last != OpCode::RETURN) {
+    throw BytecodeError(getLine(size), "Chunk does not end in RETURN.");
+  }
+
+  return result;
 }
@@ -0,0 +1,350 @@
+#include "bytecode_file.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "interned_strings.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ONOL_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static constexpr char MAGIC[4] = {'O', 'N', 'L', 'C'};
+static constexpr uint8_t CONSTANT_VALUE = 0;
+static constexpr uint8_t CONSTANT_STRING = 1;
+static constexpr uint8_t UNDECLARED = 0xff;
+
+// Read-write private mapping of a whole file: the VM quickens instructions in
+// place, and those writes must never reach the file.
+class MappedFile {
+ private:
+  uint8_t* bytes = nullptr;
+  std::size_t length = 0;
+#ifndef ONOL_HAS_MMAP
+  std::vector<uint8_t> buffer;
+#endif
+
+ public:
+  explicit MappedFile(const std::string& path) {
+#ifdef ONOL_HAS_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw BytecodeError(0, "Could not open file " + path + ".");
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+      length = static_cast<std::size_t>(info.st_size);
+      void* mapped = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE, fd, 0);
+      if (mapped != MAP_FAILED) {
+        bytes = static_cast<uint8_t*>(mapped);
+      }
+    }
+    close(fd);
+
+    if (!bytes) {
+      length = 0;
+      throw BytecodeError(0, "Could not map file " + path + ".");
+    }
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+      throw BytecodeError(0, "Could not open file " + path + ".");
+    }
+    buffer.assign(std::istreambuf_iterator<char>(file), {});
+    bytes = buffer.data();
+    length = buffer.size();
+#endif
+  }
+
+  ~MappedFile() {
+#ifdef ONOL_HAS_MMAP
+    if (bytes) {
+      munmap(bytes, length);
+    }
+#endif
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  uint8_t* data() {
+    return bytes;
+  }
+
+  std::size_t size() const {
+    return length;
+  }
+};
+
+class FileReader {
+ private:
+  uint8_t* bytes;
+  std::size_t length;
+  std::size_t position = 0;
+
+ public:
+  FileReader(uint8_t* bytes, std::size_t length)
+      : bytes(bytes), length(length) {
+  }
+
+  uint8_t* take(std::size_t count) {
+    if (count > length - position) {
+      throw BytecodeError(0, "Truncated bytecode file.");
+    }
+    uint8_t* start = bytes + position;
+    position += count;
+    return start;
+  }
+
+  uint64_t read(std::size_t size) {
+    const uint8_t* start = take(size);
+    uint64_t value = 0;
+    for (std::size_t i = 0; i < size; i++) {
+      value |= static_cast<uint64_t>(start[i]) << (8 * i);
+    }
+    return value;
+  }
+
+  std::string_view readString() {
+    uint32_t size = static_cast<uint32_t>(read(4));
+    return {reinterpret_cast<const char*>(take(size)), size};
+  }
+};
+
+class FileWriter {
+ private:
+  std::ofstream& out;
+
+ public:
+  explicit FileWriter(std::ofstream& out) : out(out) {
+  }
+
+  void write(uint64_t value, std::size_t size) {
+    for (std::size_t i = 0; i < size; i++) {
+      out.put(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+  }
+
+  void writeString(std::string_view chars) {
+    write(chars.size(), 4);
+    out.write(chars.data(), static_cast<std::streamsize>(chars.size()));
+  }
+};
+
+bool isBytecodeFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  char magic[sizeof(MAGIC)];
+  return file.read(magic, sizeof(magic)) &&
+         std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+void writeBytecodeFile(Bytecode& bytecode, const std::string& path) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    throw BytecodeError(0, "Could not write file " + path + ".");
+  }
+
+  GlobalTable* globals = bytecode.getGlobals();
+  std::size_t globalCount = globals ? globals->count() : 0;
+  std::vector<uint8_t> lines;
+  bytecode.getLines().encode(lines);
+
+  FileWriter writer(out);
+  out.write(MAGIC, sizeof(MAGIC));
+  writer.write(BYTECODE_FILE_VERSION, 2);
+  writer.write(static_cast<uint16_t>(OpCode::OPCODE_COUNT), 2);
+  writer.write(bytecode.count(), 4);
+  writer.write(bytecode.constantCount(), 4);
+  writer.write(lines.size(), 4);
+  writer.write(globalCount, 4);
+
+  // A chunk that has run holds quickened opcodes, which specialize it to the
+  // operands it has seen; the file gets the generic ones.
+  std::vector<uint8_t> code(bytecode.getCodePointer(),
+                            bytecode.getCodePointer() + bytecode.count());
+  for (std::size_t offset = 0; offset < code.size();
+       offset += instructionLength(static_cast<OpCode>(code[offset]))) {
+    code[offset] = static_cast<uint8_t>(
+        genericOpCode(static_cast<OpCode>(code[offset])));
+  }
+  out.write(reinterpret_cast<const char*>(code.data()),
+            static_cast<std::streamsize>(code.size()));
+
+  for (std::size_t i = 0; i < bytecode.constantCount(); i++) {
+    Type constant = bytecode.getConstant(i);
+    if (isString(constant)) {
+      writer.write(CONSTANT_STRING, 1);
+      writer.writeString(asString(constant)->toString());
+    } else if (isObject(constant)) {
+      throw BytecodeError(0, "Only string objects can be precompiled.");
+    } else {
+      writer.write(CONSTANT_VALUE, 1);
+      writer.write(constant.raw(), 8);
+    }
+  }
+
+  out.write(reinterpret_cast<const char*>(lines.data()),
+            static_cast<std::streamsize>(lines.size()));
+
+  for (std::size_t slot = 0; slot < globalCount; slot++) {
+    std::optional<StaticType> type = globals->getDeclaredType(slot);
+    writer.write(type ? static_cast<uint8_t>(*type) : UNDECLARED, 1);
+    writer.writeString(globals->getName(slot)->toString());
+  }
+
+  if (!out) {
+    throw BytecodeError(0, "Could not write file " + path + ".");
+  }
+}
+
+static uint8_t remapShortSlot(Bytecode& bytecode, std::size_t offset,
+                              const std::vector<std::size_t>& slots) {
+  uint8_t* code = bytecode.getCodePointer();
+  if (code[offset] >= slots.size() || slots[code[offset]] > UINT8_MAX) {
+    throw BytecodeError(bytecode.getLine(offset),
+                        "Global slot cannot be remapped.");
+  }
+  return static_cast<uint8_t>(slots[code[offset]]);
+}
+
+// Rewrites the global slot operands of every instruction from file slots to
+// table slots, rejecting slots the file does not name and the quickened
+// opcodes a file never holds. Only the bytes that change are written, so
+// untouched pages of the mapping stay shared.
+static void remapGlobals(Bytecode& bytecode,
+                         const std::vector<std::size_t>& slots) {
+  uint8_t* code = bytecode.getCodePointer();
+
+  auto setByte = [&](std::size_t offset, uint8_t value) {
+    if (code[offset] != value) {
+      code[offset] = value;
+    }
+  };
+
+  for (std::size_t offset = 0; offset < bytecode.count();) {
+    if (code[offset] >= static_cast<uint8_t>(OpCode::OPCODE_COUNT)) {
+      throw BytecodeError(bytecode.getLine(offset), "Unknown opcode.");
+    }
+    OpCode opCode = bytecode.getOpCode(offset);
+    std::size_t length = instructionLength(opCode);
+    if (offset + length > bytecode.count()) {
+      throw BytecodeError(bytecode.getLine(offset), "Truncated instruction.");
+    } else if (genericOpCode(opCode) != opCode) {
+      throw BytecodeError(bytecode.getLine(offset), "Quickened opcode.");
+    }
+
+    switch (opCode) {
+      case OpCode::DEFINE_GLOBAL:
+      case OpCode::GET_GLOBAL:
+      case OpCode::SET_GLOBAL:
+      case OpCode::SET_GLOBAL_POP:
+        setByte(offset + 1, remapShortSlot(bytecode, offset + 1, slots));
+        break;
+      case OpCode::ADD_GLOBALS:
+      case OpCode::SUBTRACT_GLOBALS:
+      case OpCode::MULTIPLY_GLOBALS:
+      case OpCode::DIVIDE_GLOBALS:
+        setByte(offset + 1, remapShortSlot(bytecode, offset + 1, slots));
+        setByte(offset + 2, remapShortSlot(bytecode, offset + 2, slots));
+        break;
+      case OpCode::DEFINE_GLOBAL_LONG:
+      case OpCode::GET_GLOBAL_LONG:
+      case OpCode::SET_GLOBAL_LONG: {
+        std::size_t slot = code[offset + 1] | (code[offset + 2] << 8) |
+                           (code[offset + 3] << 16);
+        if (slot >= slots.size()) {
+          throw BytecodeError(bytecode.getLine(offset),
+                              "Global slot cannot be remapped.");
+        }
+        setByte(offset + 1, slots[slot] & 0xff);
+        setByte(offset + 2, (slots[slot] >> 8) & 0xff);
+        setByte(offset + 3, (slots[slot] >> 16) & 0xff);
+        break;
+      }
+      default:
+        break;
+    }
+    offset += length;
+  }
+}
+
+std::shared_ptr<Bytecode> loadBytecodeFile(
+    const std::string& path, std::shared_ptr<GlobalTable> globals) {
+  auto file = std::make_shared<MappedFile>(path);
+  FileReader reader(file->data(), file->size());
+
+  if (std::memcmp(reader.take(sizeof(MAGIC)), MAGIC, sizeof(MAGIC)) != 0) {
+    throw BytecodeError(0, path + " is not a bytecode file.");
+  }
+  if (reader.read(2) != BYTECODE_FILE_VERSION ||
+      reader.read(2) != static_cast<uint16_t>(OpCode::OPCODE_COUNT)) {
+    throw BytecodeError(0, path + " was compiled by another version.");
+  }
+
+  std::size_t codeSize = reader.read(4);
+  std::size_t constantCount = reader.read(4);
+  std::size_t lineTableSize = reader.read(4);
+  std::size_t globalCount = reader.read(4);
+
+  auto bytecode = std::make_shared<Bytecode>();
+  uint8_t* code = reader.take(codeSize);
+  bytecode->mapCode(file, code, codeSize);
+
+  for (std::size_t i = 0; i < constantCount; i++) {
+    uint8_t tag = static_cast<uint8_t>(reader.read(1));
+    if (tag == CONSTANT_STRING) {
+      bytecode->appendLazyString(reader.readString());
+    } else if (tag == CONSTANT_VALUE) {
+      Type value = Type::fromBits(reader.read(8));
+      if (isObject(value) || isUndefined(value)) {
+        throw BytecodeError(0, "Invalid constant in bytecode file.");
+      }
+      bytecode->appendConstant(value);
+    } else {
+      throw BytecodeError(0, "Invalid constant in bytecode file.");
+    }
+  }
+
+  std::optional<LineTable> lines =
+      LineTable::decode(reader.take(lineTableSize), lineTableSize);
+  if (!lines) {
+    throw BytecodeError(0, "Invalid line table in bytecode file.");
+  }
+  bytecode->setLines(std::move(*lines));
+
+  std::vector<std::size_t> slots;
+  for (std::size_t i = 0; i < globalCount; i++) {
+    uint8_t type = static_cast<uint8_t>(reader.read(1));
+    std::size_t slot = globals->resolve(getOrIntern(reader.readString()));
+    slots.push_back(slot);
+
+    if (type == UNDECLARED) {
+      continue;
+    } else if (type > static_cast<uint8_t>(StaticType::STRING)) {
+      throw BytecodeError(0, "Invalid global type in bytecode file.");
+    }
+    std::optional<StaticType> declared = globals->getDeclaredType(slot);
+    if (!declared) {
+      globals->declare(slot, static_cast<StaticType>(type));
+    } else if (*declared != static_cast<StaticType>(type)) {
+      throw BytecodeError(0, "Global '" + globals->getName(slot)->toString() +
+                                 "' is already declared as " +
+                                 staticTypeName(*declared) + ".");
+    }
+  }
+
+  remapGlobals(*bytecode, slots);
+  bytecode->setGlobals(std::move(globals));
+  bytecode->stackDepth();
+  return bytecode;
+}
@@ -6,112 +6,279 @@
 #include "bytecode.hpp"
 #include "types.hpp"
 
-static std::size_t simpleInstruction(const std::string& name,
+static std::size_t simpleInstruction(std::ostream& out, const std::string& name,
                                      std::size_t offset) {
-  std::cout << name << "\n";
+  out << name << "\n";
   return offset + 1;
 }
 
-static std::size_t constantInstruction(const std::string& name,
+static std::size_t constantInstruction(std::ostream& out,
+                                       const std::string& name,
                                        Bytecode& bytecode, std::size_t offset) {
   uint8_t constantAddress = bytecode.getConstantAddress(offset + 1);
 
-  std::cout << std::left << std::setw(16) << name << std::setw(4)
-            << static_cast<int>(constantAddress) << "'";
-  std::cout << std::setfill(' ') << std::setw(0);
-  printValue(bytecode.getConstant(constantAddress));
-  std::cout << "'" << "\n";
+  out << std::left << std::setw(16) << name << std::setw(4)
+      << static_cast<int>(constantAddress) << "'";
+  out << std::setfill(' ') << std::setw(0);
+  printValue(bytecode.getConstant(constantAddress), out);
+  out << "'" << "\n";
   return offset + 2;
 }
 
-static std::size_t constantLongInstruction(const std::string& name,
+static std::size_t constantLongInstruction(std::ostream& out,
+                                           const std::string& name,
                                            Bytecode& bytecode,
                                            std::size_t offset) {
   uint32_t constantAddress = bytecode.getConstantAddress(offset + 1) |
                              (bytecode.getConstantAddress(offset + 2) << 8) |
                              (bytecode.getConstantAddress(offset + 3) << 16);
 
-  std::cout << std::left << std::setw(16) << name << std::setw(4)
-            << static_cast<int>(constantAddress) << "'";
-  std::cout << std::setfill(' ') << std::setw(0);
-  printValue(bytecode.getConstant(constantAddress));
-  std::cout << "'" << "\n";
+  out << std::left << std::setw(16) << name << std::setw(4)
+      << static_cast<int>(constantAddress) << "'";
+  out << std::setfill(' ') << std::setw(0);
+  printValue(bytecode.getConstant(constantAddress), out);
+  out << "'" << "\n";
   return offset + 4;
 }
 
-void disassembleBytecode(Bytecode& bytecode, const std::string& name) {
-  std::cout << "== " << name << " ==\n";
+static void printGlobalName(std::ostream& out, Bytecode& bytecode,
+                            std::size_t slot) {
+  GlobalTable* globals = bytecode.getGlobals();
+  if (globals && slot < globals->count()) {
+    out << globals->getName(slot)->toString();
+  }
+}
+
+static std::size_t globalInstruction(std::ostream& out, const std::string& name,
+                                     Bytecode& bytecode, std::size_t offset) {
+  uint8_t slot = bytecode.getConstantAddress(offset + 1);
+
+  out << std::left << std::setw(16) << name << std::setw(4)
+      << static_cast<int>(slot) << "'";
+  out << std::setfill(' ') << std::setw(0);
+  printGlobalName(out, bytecode, slot);
+  out << "'" << "\n";
+  return offset + 2;
+}
+
+static std::size_t globalLongInstruction(std::ostream& out,
+                                         const std::string& name,
+                                         Bytecode& bytecode,
+                                         std::size_t offset) {
+  uint32_t slot = bytecode.getConstantAddress(offset + 1) |
+                  (bytecode.getConstantAddress(offset + 2) << 8) |
+                  (bytecode.getConstantAddress(offset + 3) << 16);
+
+  out << std::left << std::setw(16) << name << std::setw(4)
+      << static_cast<int>(slot) << "'";
+  out << std::setfill(' ') << std::setw(0);
+  printGlobalName(out, bytecode, slot);
+  out << "'" << "\n";
+  return offset + 4;
+}
+
+static std::size_t globalPairInstruction(std::ostream& out,
+                                         const std::string& name,
+                                         Bytecode& bytecode,
+                                         std::size_t offset) {
+  uint8_t first = bytecode.getConstantAddress(offset + 1);
+  uint8_t second = bytecode.getConstantAddress(offset + 2);
+
+  out << std::left << std::setw(16) << name << std::setw(4)
+      << static_cast<int>(first) << std::setw(4)
+      << static_cast<int>(second) << "'";
+  out << std::setfill(' ') << std::setw(0);
+  printGlobalName(out, bytecode, first);
+  out << "' '";
+  printGlobalName(out, bytecode, second);
+  out << "'" << "\n";
+  return offset + 3;
+}
+
+static std::size_t coerceInstruction(std::ostream& out, const std::string& name,
+                                     Bytecode& bytecode, std::size_t offset) {
+  uint8_t type = bytecode.getConstantAddress(offset + 1);
+
+  out << std::left << std::setw(16) << name
+      << staticTypeName(static_cast<StaticType>(type)) << "\n";
+  return offset + 2;
+}
+
+void disassembleBytecode(Bytecode& bytecode, const std::string& name,
+                         std::ostream& out) {
+  out << "== " << name << " ==\n";
 
   for (std::size_t offset = 0; offset < bytecode.count();) {
-    offset = disassembleInstruction(bytecode, offset);
+    offset = disassembleInstruction(bytecode, offset, out);
   }
 }
 
-int disassembleInstruction(Bytecode& bytecode, uint32_t offset) {
-  std::cout << std::setfill('0') << std::setw(4) << std::right << offset << " ";
+int disassembleInstruction(Bytecode& bytecode, uint32_t offset,
+                           std::ostream& out) {
+  out << std::setfill('0') << std::setw(4) << std::right << offset << " ";
 
   if (offset > 0 && bytecode.getLine(offset) == bytecode.getLine(offset - 1)) {
-    std::cout << "   | ";
+    out << "   | ";
   } else {
-    std::cout << std::setw(4) << std::right << bytecode.getLine(offset) << " ";
+    out << std::setw(4) << std::right << bytecode.getLine(offset) << " ";
   }
 
-  std::cout << std::setfill(' ');
+  out << std::setfill(' ');
 
   OpCode opCode = bytecode.getOpCode(offset);
   switch (opCode) {
     case OpCode::CONSTANT:
-      return constantInstruction("CONSTANT", bytecode, offset);
+      return constantInstruction(out, "CONSTANT", bytecode, offset);
     case OpCode::CONSTANT_LONG:
-      return constantLongInstruction("CONSTANT_LONG", bytecode, offset);
+      return constantLongInstruction(out, "CONSTANT_LONG", bytecode, offset);
     case OpCode::DEFINE_GLOBAL:
-      return constantInstruction("DEFINE_GLOBAL", bytecode, offset);
+      return globalInstruction(out, "DEFINE_GLOBAL", bytecode, offset);
     case OpCode::DEFINE_GLOBAL_LONG:
-      return constantLongInstruction("DEFINE_GLOBAL_LONG", bytecode, offset);
+      return globalLongInstruction(out, "DEFINE_GLOBAL_LONG", bytecode,
+                                   offset);
     case OpCode::GET_GLOBAL:
-      return constantInstruction("GET_GLOBAL", bytecode, offset);
+      return globalInstruction(out, "GET_GLOBAL", bytecode, offset);
     case OpCode::GET_GLOBAL_LONG:
-      return constantLongInstruction("GET_GLOBAL_LONG", bytecode, offset);
+      return globalLongInstruction(out, "GET_GLOBAL_LONG", bytecode,
+                                   offset);
     case OpCode::SET_GLOBAL:
-      return constantInstruction("SET_GLOBAL", bytecode, offset);
+      return globalInstruction(out, "SET_GLOBAL", bytecode, offset);
     case OpCode::SET_GLOBAL_LONG:
-      return constantLongInstruction("SET_GLOBAL_LONG", bytecode, offset);
+      return globalLongInstruction(out, "SET_GLOBAL_LONG", bytecode,
+                                   offset);
     case OpCode::FALSE:
-      return simpleInstruction(std::string("FALSE"), offset);
+      return simpleInstruction(out, std::string("FALSE"), offset);
     case OpCode::TRUE:
-      return simpleInstruction(std::string("TRUE"), offset);
+      return simpleInstruction(out, std::string("TRUE"), offset);
     case OpCode::NUL:
-      return simpleInstruction(std::string("NULL"), offset);
+      return simpleInstruction(out, std::string("NULL"), offset);
     case OpCode::ADD:
-      return simpleInstruction("ADD", offset);
+      return simpleInstruction(out, "ADD", offset);
     case OpCode::SUBTRACT:
-      return simpleInstruction("SUBTRACT", offset);
+      return simpleInstruction(out, "SUBTRACT", offset);
     case OpCode::MULTIPLY:
-      return simpleInstruction("MULTIPLY", offset);
+      return simpleInstruction(out, "MULTIPLY", offset);
     case OpCode::DIVIDE:
-      return simpleInstruction("DIVIDE", offset);
+      return simpleInstruction(out, "DIVIDE", offset);
     case OpCode::NEGATE:
-      return simpleInstruction("NEGATE", offset);
+      return simpleInstruction(out, "NEGATE", offset);
     case OpCode::NOT:
-      return simpleInstruction("NOT", offset);
+      return simpleInstruction(out, "NOT", offset);
     case OpCode::EQUAL:
-      return simpleInstruction("EQUAL", offset);
+      return simpleInstruction(out, "EQUAL", offset);
     case OpCode::GREATER:
-      return simpleInstruction("GREATER", offset);
+      return simpleInstruction(out, "GREATER", offset);
     case OpCode::GREATER_EQUAL:
-      return simpleInstruction("GREATER_EQUAL", offset);
+      return simpleInstruction(out, "GREATER_EQUAL", offset);
     case OpCode::LESS:
-      return simpleInstruction("LESS", offset);
+      return simpleInstruction(out, "LESS", offset);
     case OpCode::LESS_EQUAL:
-      return simpleInstruction("LESS_EQUAL", offset);
+      return simpleInstruction(out, "LESS_EQUAL", offset);
     case OpCode::NOT_EQUAL:
-      return simpleInstruction("NOT_EQUAL", offset);
+      return simpleInstruction(out, "NOT_EQUAL", offset);
     case OpCode::POP:
-      return simpleInstruction("OP_POP", offset);
+      return simpleInstruction(out, "OP_POP", offset);
     case OpCode::RETURN:
-      return simpleInstruction(std::string("RETURN"), offset);
+      return simpleInstruction(out, std::string("RETURN"), offset);
+    case OpCode::ADD_INT:
+      return simpleInstruction(out, "ADD_INT", offset);
+    case OpCode::SUBTRACT_INT:
+      return simpleInstruction(out, "SUBTRACT_INT", offset);
+    case OpCode::MULTIPLY_INT:
+      return simpleInstruction(out, "MULTIPLY_INT", offset);
+    case OpCode::DIVIDE_INT:
+      return simpleInstruction(out, "DIVIDE_INT", offset);
+    case OpCode::ADD_DOUBLE:
+      return simpleInstruction(out, "ADD_DOUBLE", offset);
+    case OpCode::SUBTRACT_DOUBLE:
+      return simpleInstruction(out, "SUBTRACT_DOUBLE", offset);
+    case OpCode::MULTIPLY_DOUBLE:
+      return simpleInstruction(out, "MULTIPLY_DOUBLE", offset);
+    case OpCode::DIVIDE_DOUBLE:
+      return simpleInstruction(out, "DIVIDE_DOUBLE", offset);
+    case OpCode::GREATER_INT:
+      return simpleInstruction(out, "GREATER_INT", offset);
+    case OpCode::LESS_INT:
+      return simpleInstruction(out, "LESS_INT", offset);
+    case OpCode::GREATER_EQUAL_INT:
+      return simpleInstruction(out, "GREATER_EQUAL_INT", offset);
+    case OpCode::LESS_EQUAL_INT:
+      return simpleInstruction(out, "LESS_EQUAL_INT", offset);
+    case OpCode::GREATER_DOUBLE:
+      return simpleInstruction(out, "GREATER_DOUBLE", offset);
+    case OpCode::LESS_DOUBLE:
+      return simpleInstruction(out, "LESS_DOUBLE", offset);
+    case OpCode::GREATER_EQUAL_DOUBLE:
+      return simpleInstruction(out, "GREATER_EQUAL_DOUBLE", offset);
+    case OpCode::LESS_EQUAL_DOUBLE:
+      return simpleInstruction(out, "LESS_EQUAL_DOUBLE", offset);
+    case OpCode::NEGATE_INT:
+      return simpleInstruction(out, "NEGATE_INT", offset);
+    case OpCode::NEGATE_DOUBLE:
+      return simpleInstruction(out, "NEGATE_DOUBLE", offset);
+    case OpCode::CONCAT_STR:
+      return simpleInstruction(out, "CONCAT_STR", offset);
+    case OpCode::COERCE:
+      return coerceInstruction(out, "COERCE", bytecode, offset);
+    case OpCode::ADD_CONSTANT:
+      return constantInstruction(out, "ADD_CONSTANT", bytecode, offset);
+    case OpCode::SUBTRACT_CONSTANT:
+      return constantInstruction(out, "SUBTRACT_CONSTANT", bytecode, offset);
+    case OpCode::MULTIPLY_CONSTANT:
+      return constantInstruction(out, "MULTIPLY_CONSTANT", bytecode, offset);
+    case OpCode::DIVIDE_CONSTANT:
+      return constantInstruction(out, "DIVIDE_CONSTANT", bytecode, offset);
+    case OpCode::ADD_GLOBALS:
+      return globalPairInstruction(out, "ADD_GLOBALS", bytecode, offset);
+    case OpCode::SUBTRACT_GLOBALS:
+      return globalPairInstruction(out, "SUBTRACT_GLOBALS", bytecode, offset);
+    case OpCode::MULTIPLY_GLOBALS:
+      return globalPairInstruction(out, "MULTIPLY_GLOBALS", bytecode, offset);
+    case OpCode::DIVIDE_GLOBALS:
+      return globalPairInstruction(out, "DIVIDE_GLOBALS", bytecode, offset);
+    case OpCode::SET_GLOBAL_POP:
+      return globalInstruction(out, "SET_GLOBAL_POP", bytecode, offset);
+    case OpCode::ADD_INT_QUICK:
+      return simpleInstruction(out, "ADD_INT_QUICK", offset);
+    case OpCode::SUBTRACT_INT_QUICK:
+      return simpleInstruction(out, "SUBTRACT_INT_QUICK", offset);
+    case OpCode::MULTIPLY_INT_QUICK:
+      return simpleInstruction(out, "MULTIPLY_INT_QUICK", offset);
+    case OpCode::DIVIDE_INT_QUICK:
+      return simpleInstruction(out, "DIVIDE_INT_QUICK", offset);
+    case OpCode::ADD_DOUBLE_QUICK:
+      return simpleInstruction(out, "ADD_DOUBLE_QUICK", offset);
+    case OpCode::SUBTRACT_DOUBLE_QUICK:
+      return simpleInstruction(out, "SUBTRACT_DOUBLE_QUICK", offset);
+    case OpCode::MULTIPLY_DOUBLE_QUICK:
+      return simpleInstruction(out, "MULTIPLY_DOUBLE_QUICK", offset);
+    case OpCode::DIVIDE_DOUBLE_QUICK:
+      return simpleInstruction(out, "DIVIDE_DOUBLE_QUICK", offset);
+    case OpCode::GREATER_INT_QUICK:
+      return simpleInstruction(out, "GREATER_INT_QUICK", offset);
+    case OpCode::LESS_INT_QUICK:
+      return simpleInstruction(out, "LESS_INT_QUICK", offset);
+    case OpCode::GREATER_EQUAL_INT_QUICK:
+      return simpleInstruction(out, "GREATER_EQUAL_INT_QUICK", offset);
+    case OpCode::LESS_EQUAL_INT_QUICK:
+      return simpleInstruction(out, "LESS_EQUAL_INT_QUICK", offset);
+    case OpCode::GREATER_DOUBLE_QUICK:
+      return simpleInstruction(out, "GREATER_DOUBLE_QUICK", offset);
+    case OpCode::LESS_DOUBLE_QUICK:
+      return simpleInstruction(out, "LESS_DOUBLE_QUICK", offset);
+    case OpCode::GREATER_EQUAL_DOUBLE_QUICK:
+      return simpleInstruction(out, "GREATER_EQUAL_DOUBLE_QUICK", offset);
+    case OpCode::LESS_EQUAL_DOUBLE_QUICK:
+      return simpleInstruction(out, "LESS_EQUAL_DOUBLE_QUICK", offset);
+    case OpCode::CONCAT_STR_QUICK:
+      return simpleInstruction(out, "CONCAT_STR_QUICK", offset);
+    case OpCode::GET_GLOBAL_QUICK:
+      return globalInstruction(out, "GET_GLOBAL_QUICK", bytecode, offset);
+    case OpCode::GET_GLOBAL_LONG_QUICK:
+      return globalLongInstruction(out, "GET_GLOBAL_LONG_QUICK", bytecode,
+                                   offset);
     default:
-      std::cout << "Unkown opcode " << static_cast<uint8_t>(opCode) << "\n";
+      out << "Unkown opcode " << static_cast<uint8_t>(opCode) << "\n";
       return offset + 1;
   }
 }
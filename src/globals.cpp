@@ -0,0 +1,47 @@
+#include "globals.hpp"
+
+std::size_t GlobalTable::resolve(ObjString* name) {
+  auto it = slots.find(name);
+  if (it != slots.end()) {
+    return it->second;
+  }
+
+  uint32_t slot = static_cast<uint32_t>(names.size());
+  slots.emplace(name, slot);
+  names.push_back(name);
+  types.push_back(std::nullopt);
+  values.push_back(Type::undefined());
+  return slot;
+}
+
+std::optional<std::size_t> GlobalTable::find(ObjString* name) const {
+  auto it = slots.find(name);
+  if (it == slots.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+ObjString* GlobalTable::getName(std::size_t slot) const {
+  return names[slot];
+}
+
+std::size_t GlobalTable::count() const {
+  return names.size();
+}
+
+std::optional<StaticType> GlobalTable::getDeclaredType(std::size_t slot) const {
+  return types[slot];
+}
+
+StaticType GlobalTable::getType(std::size_t slot) const {
+  return types[slot].value_or(StaticType::UNKNOWN);
+}
+
+void GlobalTable::declare(std::size_t slot, StaticType type) {
+  types[slot] = type;
+}
+
+void GlobalTable::undeclare(std::size_t slot) {
+  types[slot] = std::nullopt;
+}
@@ -0,0 +1,399 @@
+#include "heap.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <new>
+
+#include "dynamic_types.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+// Times the collector work done within one call from the owner. Nested
+// calls, such as a minor collection that starts a full one, belong to the
+// same pause.
+class Heap::PauseTimer {
+ public:
+  explicit PauseTimer(Heap& heap) : heap(heap), start(Clock::now()) {
+    heap.pauseDepth++;
+  }
+
+  ~PauseTimer() {
+    if (--heap.pauseDepth > 0) {
+      return;
+    }
+    auto pause = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - start);
+    heap.pauseStats.count++;
+    heap.pauseStats.total += pause;
+    heap.pauseStats.max = std::max(heap.pauseStats.max, pause);
+  }
+
+ private:
+  Heap& heap;
+  Clock::time_point start;
+};
+
+// Counts the objects a slice visits against its budget. The clock is read
+// only for time budgets, and then once every few objects.
+class Heap::SliceDeadline {
+ public:
+  static constexpr std::size_t CLOCK_INTERVAL = 32;
+
+  explicit SliceDeadline(SliceBudget budget)
+      : left(budget.objects ? budget.objects
+                            : std::numeric_limits<std::size_t>::max()),
+        timed(budget.time.count() > 0),
+        end(Clock::now() + budget.time) {
+  }
+
+  static SliceDeadline unlimited() {
+    return SliceDeadline({0, std::chrono::microseconds(0)});
+  }
+
+  bool expired() {
+    if (left == 0) {
+      return true;
+    }
+    left--;
+    return timed && ++visited % CLOCK_INTERVAL == 0 && Clock::now() >= end;
+  }
+
+ private:
+  std::size_t left;
+  std::size_t visited = 0;
+  bool timed;
+  Clock::time_point end;
+};
+
+Heap::~Heap() {
+  // A sweep in progress has already freed the objects between its cursors.
+  if (phase == Phase::SWEEPING) {
+    objects.erase(objects.begin() + sweepKept, objects.begin() + sweepCursor);
+  }
+  for (Object* object : objects) {
+    free(object);
+  }
+}
+
+void Heap::setRootMarker(RootMarker marker) {
+  markRoots = std::move(marker);
+}
+
+void Heap::setStressMode(bool enabled) {
+  stress = enabled;
+}
+
+void Heap::setIncremental(bool enabled, SliceBudget sliceBudget) {
+  if (!enabled) {
+    finishCycle();
+  }
+  incremental = enabled;
+  budget = sliceBudget;
+}
+
+// Every byte of the old generation passes through here and reallocate, so
+// `allocated` is exact. Never collects: callers decide when to.
+void* Heap::allocateOld(std::size_t size) {
+  void* memory = reallocate(nullptr, 0, size);
+  if (!memory) {
+    throw std::bad_alloc();
+  }
+  allocated += size;
+  return memory;
+}
+
+void Heap::free(Object* object) {
+  std::size_t size = object->allocationSize();
+  object->~Object();
+  reallocate(object, size, 0);
+  allocated -= size;
+}
+
+// Reserved before an object is built so that registering it cannot fail
+// after. Capacity still grows geometrically: reserving one more slot at a
+// time would copy the whole list on every allocation.
+void Heap::reserveObject() {
+  if (objects.size() == objects.capacity()) {
+    objects.reserve(std::max<std::size_t>(64, objects.capacity() * 2));
+  }
+}
+
+ObjString* Heap::addOldString(void* memory, std::string_view chars,
+                              std::size_t hash) {
+  ObjString* string = ObjString::construct(memory, chars, hash);
+  string->managed = true;
+  string->marked = phase == Phase::MARKING;
+  objects.push_back(string);
+  strings.add(string);
+  return string;
+}
+
+ObjString* Heap::allocateString(std::string_view chars) {
+  std::size_t hash = ObjString::hashOf(chars);
+  if (ObjString* interned = findInterned(chars, hash)) {
+    return interned;
+  }
+  if (ObjString* existing = strings.find(chars, hash)) {
+    // It may be garbage the sweep has not reached yet. If it was already
+    // swept the mark only lets it float until the next cycle.
+    if (phase == Phase::SWEEPING) {
+      existing->marked = true;
+    }
+    return existing;
+  }
+  if (ObjString* existing = youngStrings.find(chars, hash)) {
+    return existing;
+  }
+
+  std::size_t size = ObjString::sizeFor(chars.size());
+  if (stress) {
+    collectNursery();
+    if (incremental) {
+      collectSlice();
+    } else {
+      collect();
+    }
+  } else if (phase != Phase::IDLE && (sinceSlice += size) >= SLICE_INTERVAL) {
+    sinceSlice = 0;
+    collectSlice();
+  }
+
+  if (size > LARGE_OBJECT) {
+    if (allocated + size > threshold) {
+      PauseTimer pause(*this);
+      collectOld();
+    }
+    reserveObject();
+    return addOldString(allocateOld(size), chars, hash);
+  }
+
+  void* memory = nursery.allocate(size);
+  if (!memory) {
+    collectNursery();
+    memory = nursery.allocate(size);
+  }
+  ObjString* string = ObjString::construct(memory, chars, hash);
+  string->managed = true;
+  youngStrings.add(string);
+  youngAllocated += size;
+  return string;
+}
+
+void Heap::markValue(Type& value) {
+  if (!isObject(value)) {
+    return;
+  }
+  Object* object = asObject(value);
+  if (nursery.contains(object)) {
+    if (emptying) {
+      value = promote(static_cast<ObjString*>(object));
+    }
+  } else if (fullCollection || phase == Phase::MARKING) {
+    markObject(object);
+  }
+}
+
+// Marks an old object gray. Strings hold no references, so blackening one
+// has nothing to scan; the worklist is what keeps slices bounded as object
+// kinds with references are added.
+void Heap::markObject(Object* object) {
+  if (object && object->managed && !object->marked) {
+    object->marked = true;
+    gray.push_back(object);
+  }
+}
+
+// Young strings are never equal to an old one when allocated, so an equal
+// old string found here is the copy made for an earlier reference to the
+// same young string. The table thus doubles as the forwarding map.
+ObjString* Heap::promote(ObjString* string) {
+  ObjString* copy = strings.find(string->view(), string->hash());
+  if (!copy) {
+    reserveObject();
+    void* memory = allocateOld(string->allocationSize());
+    copy = addOldString(memory, string->view(), string->hash());
+  }
+  if (fullCollection) {
+    copy->marked = true;
+  }
+  return copy;
+}
+
+// Dead young objects are dropped without running their destructors, which
+// strings do not need.
+void Heap::emptyNursery() {
+  if (stress) {
+    nursery.scrub(0xdb);
+  }
+  youngStrings.clear();
+  youngAllocated = 0;
+  nursery.reset();
+}
+
+void Heap::scanRoots(RootScan roots, bool emptiesNursery) {
+  scan = roots;
+  emptying = emptiesNursery;
+  if (markRoots) {
+    markRoots(*this);
+  }
+  scan = RootScan::ALL;
+  emptying = false;
+}
+
+void Heap::collectNursery() {
+  PauseTimer pause(*this);
+  scanRoots(RootScan::YOUNG, true);
+  emptyNursery();
+  nurseryCollectionCount++;
+
+  if (allocated > threshold) {
+    collectOld();
+  }
+}
+
+// The old generation has passed its threshold.
+void Heap::collectOld() {
+  if (!incremental) {
+    collect();
+  } else if (phase == Phase::IDLE) {
+    startCycle();
+  } else if (allocated > threshold * GROWTH_FACTOR) {
+    // Allocation is outrunning the slices; finish rather than grow on.
+    finishCycle();
+  }
+}
+
+void Heap::collect() {
+  PauseTimer pause(*this);
+  finishCycle();
+
+  fullCollection = true;
+  scanRoots(RootScan::ALL, true);
+  fullCollection = false;
+  gray.clear();
+  emptyNursery();
+  sweep();
+  finishCollection();
+}
+
+void Heap::sweep() {
+  // Runs while the marks are still set.
+  strings.removeUnmarked();
+  auto live =
+      std::remove_if(objects.begin(), objects.end(), [this](Object* object) {
+        if (object->marked) {
+          object->marked = false;
+          return false;
+        }
+        free(object);
+        return true;
+      });
+  objects.erase(live, objects.end());
+}
+
+void Heap::finishCollection() {
+  threshold = std::max(MIN_THRESHOLD, allocated * GROWTH_FACTOR);
+  collectionCount++;
+}
+
+void Heap::collectSlice() {
+  PauseTimer pause(*this);
+  SliceDeadline deadline(budget);
+  switch (phase) {
+    case Phase::IDLE:
+      startCycle();
+      break;
+    case Phase::MARKING:
+      if (markSlice(deadline)) {
+        finishMarking();
+      }
+      break;
+    case Phase::SWEEPING:
+      sweepSlice(deadline);
+      break;
+  }
+}
+
+void Heap::finishCycle() {
+  SliceDeadline deadline = SliceDeadline::unlimited();
+  if (phase == Phase::MARKING) {
+    markSlice(deadline);
+    finishMarking();
+  }
+  if (phase == Phase::SWEEPING) {
+    sweepSlice(deadline);
+  }
+}
+
+void Heap::startCycle() {
+  phase = Phase::MARKING;
+  sinceSlice = 0;
+  scanRoots(RootScan::ALL, false);
+}
+
+bool Heap::markSlice(SliceDeadline& deadline) {
+  while (!gray.empty()) {
+    if (deadline.expired()) {
+      return false;
+    }
+    gray.pop_back();
+  }
+  return true;
+}
+
+// The stack changed since the roots were scanned without a barrier, so it
+// is scanned again; what it adds is at most its own size.
+void Heap::finishMarking() {
+  scanRoots(RootScan::STACK, false);
+  gray.clear();
+
+  phase = Phase::SWEEPING;
+  sweepKept = 0;
+  sweepCursor = 0;
+  sweepEnd = objects.size();
+}
+
+bool Heap::sweepSlice(SliceDeadline& deadline) {
+  while (sweepCursor < sweepEnd) {
+    if (deadline.expired()) {
+      return false;
+    }
+    Object* object = objects[sweepCursor++];
+    if (object->marked) {
+      object->marked = false;
+      objects[sweepKept++] = object;
+    } else {
+      if (auto* string = dynamic_cast<ObjString*>(object)) {
+        strings.remove(string);
+      }
+      free(object);
+    }
+  }
+
+  objects.erase(objects.begin() + sweepKept, objects.begin() + sweepEnd);
+  phase = Phase::IDLE;
+  finishCollection();
+  return true;
+}
+
+void Heap::report(std::ostream& out) const {
+  auto micros = [](std::chrono::nanoseconds time) {
+    return std::chrono::duration<double, std::micro>(time).count();
+  };
+
+  out << "== gc ==\n"
+      << std::left << std::setw(20) << "mode" << std::right << std::setw(14)
+      << (incremental ? "incremental" : "stop-the-world") << "\n"
+      << std::left << std::setw(20) << "minor collections" << std::right
+      << std::setw(14) << nurseryCollectionCount << "\n"
+      << std::left << std::setw(20) << "full collections" << std::right
+      << std::setw(14) << collectionCount << "\n"
+      << std::left << std::setw(20) << "pauses" << std::right
+      << std::setw(14) << pauseStats.count << "\n"
+      << std::fixed << std::setprecision(1) << std::left << std::setw(20)
+      << "max pause us" << std::right << std::setw(14)
+      << micros(pauseStats.max) << "\n"
+      << std::left << std::setw(20) << "total pause us" << std::right
+      << std::setw(14) << micros(pauseStats.total) << "\n";
+}
@@ -1,34 +1,257 @@
 #include "interned_strings.hpp"
 
-ObjString* getOrIntern(String value) {
-  static std::unordered_map<String, ObjString*> strings;
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 
-  auto it = strings.find(value);
-  if (it != strings.end()) {
-    return it->second;
+static constexpr std::size_t MIN_CAPACITY = 64;
+
+// `slots` is empty or a power of two in size.
+static ObjString* findIn(const std::vector<ObjString*>& slots,
+                         std::string_view chars, std::size_t hash) {
+  if (slots.empty()) {
+    return nullptr;
+  }
+
+  std::size_t mask = slots.size() - 1;
+  for (std::size_t index = hash & mask;; index = (index + 1) & mask) {
+    ObjString* string = slots[index];
+    if (!string) {
+      return nullptr;
+    }
+    if (string->hash() == hash && string->view() == chars) {
+      return string;
+    }
+  }
+}
+
+static void placeIn(std::vector<ObjString*>& slots, ObjString* string) {
+  std::size_t mask = slots.size() - 1;
+  std::size_t index = string->hash() & mask;
+  while (slots[index]) {
+    index = (index + 1) & mask;
+  }
+  slots[index] = string;
+}
+
+// Rebuilds `slots` at `capacity` from the strings `keep` accepts.
+template <typename Keep>
+static void rehash(std::vector<ObjString*>& slots, std::size_t capacity,
+                   Keep keep) {
+  std::vector<ObjString*> old = std::move(slots);
+  slots.assign(capacity, nullptr);
+  for (ObjString* string : old) {
+    if (string && keep(string)) {
+      placeIn(slots, string);
+    }
+  }
+}
+
+// Kept at most 3/4 full so probe runs stay short.
+static bool needsGrowth(const std::vector<ObjString*>& slots,
+                        std::size_t count) {
+  return (count + 1) * 4 > slots.size() * 3;
+}
+
+static std::size_t grownCapacity(const std::vector<ObjString*>& slots) {
+  return slots.empty() ? MIN_CAPACITY : slots.size() * 2;
+}
+
+ObjString* WeakStringTable::find(std::string_view chars,
+                                 std::size_t hash) const {
+  return findIn(slots, chars, hash);
+}
+
+void WeakStringTable::add(ObjString* string) {
+  if (needsGrowth(slots, count)) {
+    rehash(slots, grownCapacity(slots), [](ObjString*) { return true; });
+  }
+  placeIn(slots, string);
+  count++;
+}
+
+// Entries after the removed one are shifted back into the hole unless
+// their home slot lies between the hole and them, so no probe run is
+// broken.
+void WeakStringTable::remove(ObjString* string) {
+  if (slots.empty()) {
+    return;
+  }
+
+  std::size_t mask = slots.size() - 1;
+  std::size_t hole = string->hash() & mask;
+  while (slots[hole] != string) {
+    if (!slots[hole]) {
+      return;
+    }
+    hole = (hole + 1) & mask;
+  }
+
+  for (std::size_t index = (hole + 1) & mask; slots[index];
+       index = (index + 1) & mask) {
+    // Distances from the hole, wrapping around the table.
+    std::size_t home = (slots[index]->hash() - hole) & mask;
+    if (home != 0 && home <= ((index - hole) & mask)) {
+      continue;
+    }
+    slots[hole] = slots[index];
+    hole = index;
+  }
+  slots[hole] = nullptr;
+  count--;
+}
+
+// Removing dead entries one at a time would cost a probe each, so the
+// survivors are rehashed into a table sized for them. A sweep already
+// touches every object, so the extra pass over the slots does not change
+// its cost.
+void WeakStringTable::removeUnmarked() {
+  std::size_t live = 0;
+  for (ObjString* string : slots) {
+    if (string && string->marked) live++;
+  }
+
+  std::size_t capacity = 0;
+  if (live > 0) {
+    capacity = MIN_CAPACITY;
+    while (live * 4 > capacity * 3) capacity *= 2;
+  }
+  rehash(slots, capacity,
+         [](ObjString* string) { return string->marked; });
+  count = live;
+}
+
+void WeakStringTable::clear() {
+  std::fill(slots.begin(), slots.end(), nullptr);
+  count = 0;
+}
+
+// The tables index with the low bits of a hash, so shards are picked from
+// the high bits of a multiplicative rehash.
+std::size_t ConcurrentStringTable::shardOf(std::size_t hash) {
+  uint64_t mixed = static_cast<uint64_t>(hash) * 0x9e3779b97f4a7c15;
+  return mixed >> (64 - SHARD_BITS);
+}
+
+ObjString* ConcurrentStringTable::find(const Slots* slots,
+                                       std::string_view chars,
+                                       std::size_t hash) {
+  if (!slots) {
+    return nullptr;
+  }
+
+  std::size_t mask = slots->capacity - 1;
+  for (std::size_t index = hash & mask;; index = (index + 1) & mask) {
+    ObjString* string = slots->entries[index].load(std::memory_order_acquire);
+    if (!string) {
+      return nullptr;
+    }
+    if (string->hash() == hash && string->view() == chars) {
+      return string;
+    }
+  }
+}
+
+ObjString* ConcurrentStringTable::find(std::string_view chars,
+                                       std::size_t hash) const {
+  const Shard& shard = shards[shardOf(hash)];
+  return find(shard.slots.load(std::memory_order_acquire), chars, hash);
+}
+
+ObjString* ConcurrentStringTable::intern(std::string_view chars) {
+  std::size_t hash = ObjString::hashOf(chars);
+  Shard& shard = shards[shardOf(hash)];
+  if (ObjString* existing =
+          find(shard.slots.load(std::memory_order_acquire), chars, hash)) {
+    return existing;
+  }
+
+  std::lock_guard lock(shard.mutex);
+  Slots* slots = shard.slots.load(std::memory_order_relaxed);
+  if (ObjString* existing = find(slots, chars, hash)) {
+    return existing;
+  }
+
+  if (!slots || (shard.count + 1) * 4 > slots->capacity * 3) {
+    grow(shard);
+    slots = shard.slots.load(std::memory_order_relaxed);
+  }
+
+  ObjString* string = ObjString::create(chars, hash);
+  std::size_t mask = slots->capacity - 1;
+  std::size_t index = hash & mask;
+  while (slots->entries[index].load(std::memory_order_relaxed)) {
+    index = (index + 1) & mask;
+  }
+  slots->entries[index].store(string, std::memory_order_release);
+  shard.count++;
+  return string;
+}
+
+void ConcurrentStringTable::grow(Shard& shard) {
+  Slots* old = shard.slots.load(std::memory_order_relaxed);
+  std::size_t capacity = old ? old->capacity * 2 : MIN_CAPACITY;
+  auto grown = std::make_unique<Slots>(
+      Slots{capacity, std::make_unique<std::atomic<ObjString*>[]>(capacity)});
+
+  std::size_t mask = capacity - 1;
+  for (std::size_t i = 0; old && i < old->capacity; i++) {
+    ObjString* string = old->entries[i].load(std::memory_order_relaxed);
+    if (!string) continue;
+    std::size_t index = string->hash() & mask;
+    while (grown->entries[index].load(std::memory_order_relaxed)) {
+      index = (index + 1) & mask;
+    }
+    grown->entries[index].store(string, std::memory_order_relaxed);
   }
 
-  ObjString* obj = allocateAndConstruct<ObjString>(std::move(value));
-  strings[obj->value] = obj;
-  return obj;
+  shard.slots.store(grown.get(), std::memory_order_release);
+  shard.arrays.push_back(std::move(grown));
+}
+
+ConcurrentStringTable::~ConcurrentStringTable() {
+  clear();
+}
+
+void ConcurrentStringTable::clear() {
+  for (Shard& shard : shards) {
+    std::lock_guard lock(shard.mutex);
+    Slots* slots = shard.slots.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; slots && i < slots->capacity; i++) {
+      ObjString::destroy(slots->entries[i].load(std::memory_order_relaxed));
+    }
+    shard.slots.store(nullptr, std::memory_order_relaxed);
+    shard.arrays.clear();
+    shard.count = 0;
+  }
+}
+
+std::size_t ConcurrentStringTable::size() const {
+  std::size_t total = 0;
+  for (const Shard& shard : shards) {
+    std::lock_guard lock(shard.mutex);
+    total += shard.count;
+  }
+  return total;
+}
+
+static ConcurrentStringTable& internedStrings() {
+  static ConcurrentStringTable strings;
+  return strings;
 }
 
 ObjString* getOrIntern(std::string_view value) {
-  return getOrIntern(String(value.begin(), value.end(), Allocator<char>()));
+  return internedStrings().intern(value);
 }
 
 ObjString* getOrIntern(const char* value) {
-  return getOrIntern(String(value, value + std::strlen(value), Allocator<char>()));
+  return getOrIntern(std::string_view(value, std::strlen(value)));
 }
 
-void clearInternedStrings() {
-  static std::unordered_map<String, ObjString*>& strings = []() -> auto& {
-    static std::unordered_map<String, ObjString*> staticStrings;
-    return staticStrings;
-  }();
+ObjString* findInterned(std::string_view value, std::size_t hash) {
+  return internedStrings().find(value, hash);
+}
 
-  for (auto& [key, value] : strings) {
-    destructAndDeallocate(value);
-  }
-  strings.clear();
+void clearInternedStrings() {
+  internedStrings().clear();
 }
@@ -0,0 +1,102 @@
+#include "line_table.hpp"
+
+#include <algorithm>
+
+void LineTable::add(std::size_t offset, uint32_t line) {
+  if (!starts.empty() && starts.back().line == line) {
+    return;
+  }
+  starts.push_back({static_cast<uint32_t>(offset), line});
+}
+
+void LineTable::truncate(std::size_t count) {
+  while (!starts.empty() && starts.back().offset >= count) {
+    starts.pop_back();
+  }
+}
+
+void LineTable::clear() {
+  starts.clear();
+  starts.shrink_to_fit();
+}
+
+void LineTable::swap(LineTable& other) {
+  starts.swap(other.starts);
+}
+
+uint32_t LineTable::getLine(std::size_t offset) const {
+  auto it = std::upper_bound(
+      starts.begin(), starts.end(), offset,
+      [](std::size_t value, const LineStart& start) {
+        return value < start.offset;
+      });
+  if (it == starts.begin()) {
+    return 0;
+  }
+  return std::prev(it)->line;
+}
+
+std::size_t LineTable::size() const {
+  return starts.size();
+}
+
+static void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+static bool getVarint(const uint8_t*& bytes, const uint8_t* end,
+                      uint64_t& value) {
+  value = 0;
+  for (int shift = 0; bytes < end && shift < 64; shift += 7) {
+    uint8_t byte = *bytes++;
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void LineTable::encode(std::vector<uint8_t>& out) const {
+  uint32_t offset = 0;
+  int64_t line = 0;
+  for (const LineStart& start : starts) {
+    int64_t lineDelta = static_cast<int64_t>(start.line) - line;
+    putVarint(out, start.offset - offset);
+    putVarint(out, (static_cast<uint64_t>(lineDelta) << 1) ^
+                       static_cast<uint64_t>(lineDelta >> 63));
+    offset = start.offset;
+    line = start.line;
+  }
+}
+
+std::optional<LineTable> LineTable::decode(const uint8_t* bytes,
+                                           std::size_t length) {
+  LineTable table;
+  const uint8_t* end = bytes + length;
+  uint64_t offset = 0;
+  int64_t line = 0;
+
+  while (bytes < end) {
+    uint64_t offsetDelta;
+    uint64_t zigzag;
+    if (!getVarint(bytes, end, offsetDelta) ||
+        !getVarint(bytes, end, zigzag)) {
+      return std::nullopt;
+    }
+
+    offset += offsetDelta;
+    line += static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+    if (offset > UINT32_MAX || line < 0 || line > UINT32_MAX ||
+        (!table.starts.empty() && offsetDelta == 0)) {
+      return std::nullopt;
+    }
+    table.starts.push_back(
+        {static_cast<uint32_t>(offset), static_cast<uint32_t>(line)});
+  }
+  return table;
+}
@@ -1,7 +1,14 @@
+#include <charconv>
+#include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <string_view>
 
+#include "bytecode_file.hpp"
+#include "tracer.hpp"
 #include "vm.hpp"
 
 VM vm;
@@ -37,21 +44,147 @@ static void repl() {
 }
 
 static void runFile(const char* path) {
-  std::string source = readFile(path);
-  InterpretResult result = vm.interpret(source);
+  InterpretResult result;
+  if (isBytecodeFile(path)) {
+    std::shared_ptr<Bytecode> chunk = vm.load(path);
+    if (!chunk) exit(65);
+    result = vm.interpret(chunk);
+  } else {
+    result = vm.interpret(readFile(path));
+  }
 
   if (result == InterpretResult::INTERPRET_COMPILE_ERROR) exit(65);
   if (result == InterpretResult::INTERPRET_RUNTIME_ERROR) exit(70);
 }
 
+static void compileFile(const char* path, const char* output) {
+  std::shared_ptr<Bytecode> chunk = vm.compile(readFile(path));
+  if (!chunk) exit(65);
+
+  try {
+    writeBytecodeFile(*chunk, output);
+  } catch (const InterpreterError& ex) {
+    std::cerr << ex.what() << "\n";
+    exit(74);
+  }
+}
+
+static void printProfile() {
+  vm.getProfiler()->report(std::cerr);
+}
+
+static void printGCStats() {
+  vm.getHeap().report(std::cerr);
+}
+
+// A slice budget is a number of objects, or of microseconds with "us".
+static std::optional<Heap::SliceBudget> parseSliceBudget(
+    std::string_view text) {
+  bool micros = text.ends_with("us");
+  if (micros) text.remove_suffix(2);
+
+  std::size_t amount = 0;
+  auto [end, error] =
+      std::from_chars(text.data(), text.data() + text.size(), amount);
+  if (error != std::errc() || end != text.data() + text.size() ||
+      amount == 0) {
+    return std::nullopt;
+  }
+
+  Heap::SliceBudget budget;
+  if (micros) {
+    budget.objects = 0;
+    budget.time = std::chrono::microseconds(amount);
+  } else {
+    budget.objects = amount;
+  }
+  return budget;
+}
+
+static void usage() {
+  std::cerr << "Usage: onol [--no-optimize] [--profile] [--trace[=flags]]\n"
+               "            [--trace-file=path] [--stress-gc]\n"
+               "            [--incremental-gc[=budget]] [--gc-stats] [path]\n"
+               "       onol [--no-optimize] --compile path -o output\n"
+               "Trace flags: ops, stack, code (default: all)\n"
+               "GC slice budget: objects, or microseconds as Nus "
+               "(default: 1000)\n";
+  exit(64);
+}
+
 int main(int argc, const char* argv[]) {
-  if (argc == 1) {
-    repl();
-  } else if (argc == 2) {
-    runFile(argv[1]);
+  const char* path = nullptr;
+  const char* output = nullptr;
+  bool compile = false;
+  std::optional<unsigned> traceFlags;
+  const char* traceFile = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "--no-optimize") {
+      vm.setOptimize(false);
+    } else if (arg == "--profile") {
+      if (!vm.enableProfiling()) {
+        std::cerr << "onol was built without ONOL_PROFILER.\n";
+        exit(64);
+      }
+      // Runs before the VM is destroyed, including on error exits.
+      std::atexit(printProfile);
+    } else if (arg == "--trace") {
+      traceFlags = Tracer::ALL;
+    } else if (arg.starts_with("--trace=")) {
+      traceFlags = Tracer::parseFlags(arg.substr(8));
+      if (!traceFlags || *traceFlags == 0) usage();
+    } else if (arg.starts_with("--trace-file=") && arg.size() > 13) {
+      traceFile = argv[i] + 13;
+    } else if (arg == "--stress-gc") {
+      vm.setStressGC(true);
+    } else if (arg == "--incremental-gc") {
+      vm.setIncrementalGC(true);
+    } else if (arg.starts_with("--incremental-gc=")) {
+      std::optional<Heap::SliceBudget> budget =
+          parseSliceBudget(arg.substr(17));
+      if (!budget) usage();
+      vm.setIncrementalGC(true, *budget);
+    } else if (arg == "--gc-stats") {
+      std::atexit(printGCStats);
+    } else if (arg == "--compile") {
+      compile = true;
+    } else if (arg == "-o" && i + 1 < argc && !output) {
+      output = argv[++i];
+    } else if (!path && !arg.starts_with("-")) {
+      path = argv[i];
+    } else {
+      usage();
+    }
+  }
+
+  if (compile != (output != nullptr) || (compile && !path)) {
+    usage();
+  }
+
+  if (traceFile && !traceFlags) {
+    traceFlags = Tracer::ALL;
+  }
+  if (traceFlags) {
+    if (traceFile) {
+      std::unique_ptr<Tracer> tracer = Tracer::toFile(*traceFlags, traceFile);
+      if (!tracer) {
+        std::cerr << "Could not open trace file " << traceFile << ".\n";
+        exit(74);
+      }
+      vm.setTracer(std::move(tracer));
+    } else {
+      vm.setTracer(std::make_unique<Tracer>(*traceFlags, std::cerr));
+    }
+  }
+
+  if (compile) {
+    compileFile(path, output);
+  } else if (path) {
+    runFile(path);
   } else {
-    std::cerr << "Usage: onol [path]\n";
-    exit(64);
+    repl();
   }
 
   return 0;
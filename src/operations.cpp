@@ -0,0 +1,76 @@
+#include "operations.hpp"
+
+String toString(const Type& value) {
+  if (isBool(value)) {
+    return asBool(value) ? "true" : "false";
+  } else if (isNull(value)) {
+    return "null";
+  } else if (isInt(value)) {
+    std::string str = std::to_string(asInt(value));
+    return String(str.begin(), str.end(), Allocator<char>());
+  } else if (isDouble(value)) {
+    std::string str = std::to_string(asDouble(value));
+    return String(str.begin(), str.end(), Allocator<char>());
+  }
+
+  auto objStr = dynamic_cast<ObjString*>(asObject(value));
+  if (objStr) {
+    return String(objStr->view(), Allocator<char>());
+  }
+  return "object";
+}
+
+Type makeString(std::string_view chars, Heap* heap) {
+  if (heap) {
+    return heap->allocateString(chars);
+  }
+  return getOrIntern(chars);
+}
+
+// Equal strings are normally one object (see Heap). The contents check
+// covers a runtime string made before an equal literal was compiled.
+bool valuesEqual(const Type& a, const Type& b) {
+  if (a == b) {
+    return true;
+  }
+  return isString(a) && isString(b) && *asObject(a) == *asObject(b);
+}
+
+OperationResult negate(const Type& value) {
+  if (isInt(value)) {
+    return {negateInt(asInt(value))};
+  } else if (isDouble(value)) {
+    return {-asDouble(value)};
+  }
+  return {Type(), "Operand must be a number."};
+}
+
+OperationResult logicalNot(const Type& value) {
+  if (isBool(value)) {
+    return {!asBool(value)};
+  }
+  return {Type(), "Operand must be a boolean value."};
+}
+
+// Converts a value stored into a variable declared as `type`. Ints widen to
+// doubles; any other mismatch is an error.
+OperationResult coerce(const Type& value, StaticType type) {
+  StaticType actual = staticTypeOf(value);
+  if (type == StaticType::UNKNOWN || actual == type) {
+    return {value};
+  } else if (type == StaticType::DOUBLE && actual == StaticType::INT) {
+    return {static_cast<double>(asInt(value))};
+  }
+  return {Type(), "Value does not match the declared type of the variable."};
+}
+
+// Both operands must be strings.
+Type concatenateStrings(const Type& a, const Type& b, Heap* heap) {
+  std::string_view lhs = static_cast<ObjString*>(asObject(a))->view();
+  std::string_view rhs = static_cast<ObjString*>(asObject(b))->view();
+
+  String result(Allocator<char>{});
+  result.reserve(lhs.size() + rhs.size());
+  result.append(lhs).append(rhs);
+  return makeString(result, heap);
+}
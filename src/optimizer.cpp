@@ -0,0 +1,157 @@
+#include "optimizer.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// A decoded instruction of the chunk being rewritten.
+struct Instruction {
+  OpCode opCode;
+  std::size_t offset;
+  std::size_t length;
+  uint32_t line;
+};
+
+static std::vector<Instruction> decode(Bytecode& bytecode) {
+  std::vector<Instruction> instructions;
+  for (std::size_t offset = 0; offset < bytecode.count();) {
+    OpCode opCode = bytecode.getOpCode(offset);
+    std::size_t length = instructionLength(opCode);
+    instructions.push_back({opCode, offset, length, bytecode.getLine(offset)});
+    offset += length;
+  }
+  return instructions;
+}
+
+static std::optional<OpCode> constantForm(OpCode arithmetic) {
+  switch (arithmetic) {
+    case OpCode::ADD:
+      return OpCode::ADD_CONSTANT;
+    case OpCode::SUBTRACT:
+      return OpCode::SUBTRACT_CONSTANT;
+    case OpCode::MULTIPLY:
+      return OpCode::MULTIPLY_CONSTANT;
+    case OpCode::DIVIDE:
+      return OpCode::DIVIDE_CONSTANT;
+    default:
+      return std::nullopt;
+  }
+}
+
+static std::optional<OpCode> globalsForm(OpCode arithmetic) {
+  switch (arithmetic) {
+    case OpCode::ADD:
+      return OpCode::ADD_GLOBALS;
+    case OpCode::SUBTRACT:
+      return OpCode::SUBTRACT_GLOBALS;
+    case OpCode::MULTIPLY:
+      return OpCode::MULTIPLY_GLOBALS;
+    case OpCode::DIVIDE:
+      return OpCode::DIVIDE_GLOBALS;
+    default:
+      return std::nullopt;
+  }
+}
+
+static bool isValueLoad(OpCode opCode) {
+  switch (opCode) {
+    case OpCode::CONSTANT:
+    case OpCode::CONSTANT_LONG:
+    case OpCode::NUL:
+    case OpCode::TRUE:
+    case OpCode::FALSE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Rewrites one pass over the chunk into `output`. Returns whether any
+// sequence was rewritten. Fused instructions keep the line of the first
+// instruction they replace, so runtime errors report the same line as the
+// unfused code.
+static bool rewrite(Bytecode& bytecode, Bytecode& output) {
+  std::vector<Instruction> in = decode(bytecode);
+  bool changed = false;
+
+  auto is = [&](std::size_t i, OpCode opCode) {
+    return i < in.size() && in[i].opCode == opCode;
+  };
+  auto operand = [&](std::size_t i, std::size_t n = 1) {
+    return bytecode.getConstantAddress(in[i].offset + n);
+  };
+
+  for (std::size_t i = 0; i < in.size();) {
+    const Instruction& instr = in[i];
+
+    if (is(i, OpCode::GET_GLOBAL) && is(i + 1, OpCode::GET_GLOBAL) &&
+        i + 2 < in.size()) {
+      if (auto fused = globalsForm(in[i + 2].opCode)) {
+        output.putOpCode(*fused, instr.line);
+        output.putRaw(operand(i), instr.line);
+        output.putRaw(operand(i + 1), instr.line);
+        i += 3;
+        changed = true;
+        continue;
+      }
+    }
+
+    if (is(i, OpCode::CONSTANT) && i + 1 < in.size()) {
+      if (auto fused = constantForm(in[i + 1].opCode)) {
+        output.putOpCode(*fused, instr.line);
+        output.putRaw(operand(i), instr.line);
+        i += 2;
+        changed = true;
+        continue;
+      }
+    }
+
+    if (is(i, OpCode::SET_GLOBAL) && is(i + 1, OpCode::POP)) {
+      output.putOpCode(OpCode::SET_GLOBAL_POP, instr.line);
+      output.putRaw(operand(i), instr.line);
+      i += 2;
+      changed = true;
+      continue;
+    }
+
+    if ((is(i, OpCode::EQUAL) || is(i, OpCode::NOT_EQUAL)) &&
+        is(i + 1, OpCode::NOT)) {
+      output.putOpCode(is(i, OpCode::EQUAL) ? OpCode::NOT_EQUAL
+                                            : OpCode::EQUAL,
+                       instr.line);
+      i += 2;
+      changed = true;
+      continue;
+    }
+
+    // A literal whose value is discarded straight away never has side
+    // effects.
+    if (isValueLoad(instr.opCode) && is(i + 1, OpCode::POP)) {
+      i += 2;
+      changed = true;
+      continue;
+    }
+
+    output.putOpCode(instr.opCode, instr.line);
+    for (std::size_t n = 1; n < instr.length; n++) {
+      output.putRaw(operand(i, n), instr.line);
+    }
+    i++;
+  }
+
+  return changed;
+}
+
+// The language has no jumps yet, so sequences can be rewritten without
+// relocating branch targets. Each pass may expose new sequences (e.g. a
+// dropped literal), so passes repeat until nothing changes.
+void optimizeBytecode(Bytecode& bytecode) {
+  bool changed = true;
+  while (changed) {
+    Bytecode output;
+    changed = rewrite(bytecode, output);
+    if (changed) {
+      bytecode.swapCode(output);
+    }
+  }
+}
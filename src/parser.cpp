@@ -1,100 +1,155 @@
 #include "parser.hpp"
 
+#include <algorithm>
+#include <array>
 #include <memory>
 #include <string_view>
-#include <unordered_map>
 
 #include "bytecode.hpp"
-#include "debug.hpp"
 #include "interned_strings.hpp"
+#include "operations.hpp"
+#include "optimizer.hpp"
 #include "token.hpp"
 
-Parser::Parser() {
-  initializeRules();
-}
-
-void Parser::initializeRules() {
-  auto bindMethod = [this](void (Parser::*method)()) -> ParseFn {
-    return [this, method]() { (this->*method)(); };
-  };
-
-  rules = std::unordered_map<TokenType, ParseRule>{
-      {TokenType::LEFT_PAREN,
-       {bindMethod(&Parser::parseGroup), nullptr, Precedence::NONE}},
-      {TokenType::RIGHT_PAREN, {nullptr, nullptr, Precedence::NONE}},
-      {TokenType::LEFT_BRACE, {nullptr, nullptr, Precedence::NONE}},
-      {TokenType::RIGHT_BRACE, {nullptr, nullptr, Precedence::NONE}},
-      {TokenType::COMMA, {nullptr, nullptr, Precedence::NONE}},
-      {TokenType::DOT, {nullptr, nullptr, Precedence::NONE}},
-      {TokenType::MINUS,
-       {bindMethod(&Parser::parseUnaryExpr),
-        bindMethod(&Parser::parseBinaryExpr), Precedence::TERM}},
-      {TokenType::PLUS,
-       {nullptr, bindMethod(&Parser::parseBinaryExpr), Precedence::TERM}},
-      {TokenType::SEMICOLON, {nullptr, nullptr, Precedence::NONE}},
-      {TokenType::COLON, {nullptr, nullptr, Precedence::NONE}},
-      {TokenType::SLASH,
-       {nullptr, bindMethod(&Parser::parseBinaryExpr), Precedence::FACTOR}},
-      {TokenType::STAR,
-       {nullptr, bindMethod(&Parser::parseBinaryExpr), Precedence::FACTOR}},
-
-      {TokenType::BANG,
-       {bindMethod(&Parser::parseUnaryExpr), nullptr, Precedence::NONE}},
-      {TokenType::BANG_EQUAL,
-       {nullptr, bindMethod(&Parser::parseBinaryExpr), Precedence::EQUALITY}},
-      {TokenType::EQUAL, {nullptr, nullptr, Precedence::ASSIGNMENT}},
-      {TokenType::EQUAL_EQUAL,
-       {nullptr, bindMethod(&Parser::parseBinaryExpr), Precedence::EQUALITY}},
-      {TokenType::GREATER,
-       {nullptr, bindMethod(&Parser::parseBinaryExpr), Precedence::COMPARISON}},
-      {TokenType::GREATER_EQUAL,
-       {nullptr, bindMethod(&Parser::parseBinaryExpr), Precedence::COMPARISON}},
-      {TokenType::LESS,
-       {nullptr, bindMethod(&Parser::parseBinaryExpr), Precedence::COMPARISON}},
-      {TokenType::LESS_EQUAL,
-       {nullptr, bindMethod(&Parser::parseBinaryExpr), Precedence::COMPARISON}},
-
-      {TokenType::IDENTIFIER,
-       {bindMethod(&Parser::var), nullptr, Precedence::NONE}},
-      {TokenType::STRING,
-       {bindMethod(&Parser::parseString), nullptr, Precedence::NONE}},
-      {TokenType::INTEGER,
-       {bindMethod(&Parser::parseNumber), nullptr, Precedence::NONE}},
-      {TokenType::DOUBLE,
-       {bindMethod(&Parser::parseNumber), nullptr, Precedence::NONE}},
-      {TokenType::LET_STRING, {nullptr, nullptr, Precedence::NONE}},
-      {TokenType::LET_INTEGER, {nullptr, nullptr, Precedence::NONE}},
-      {TokenType::LET_DOUBLE, {nullptr, nullptr, Precedence::NONE}},
-      {TokenType::LET_BOOL, {nullptr, nullptr, Precedence::NONE}},
-
-      {TokenType::INTERFACE, {nullptr, nullptr, Precedence::NONE}},
-      {TokenType::STRUCT, {nullptr, nullptr, Precedence::NONE}},
-      {TokenType::FN, {nullptr, nullptr, Precedence::NONE}},
-      {TokenType::MUT, {nullptr, nullptr, Precedence::NONE}},
-      {TokenType::LET, {nullptr, nullptr, Precedence::NONE}},
-      {TokenType::FOR, {nullptr, nullptr, Precedence::NONE}},
-      {TokenType::IN, {nullptr, nullptr, Precedence::NONE}},
-      {TokenType::RETURN, {nullptr, nullptr, Precedence::NONE}},
-      {TokenType::RETURNIF, {nullptr, nullptr, Precedence::NONE}},
-      {TokenType::IF, {nullptr, nullptr, Precedence::NONE}},
-      {TokenType::ELSE, {nullptr, nullptr, Precedence::NONE}},
-      {TokenType::OR, {nullptr, nullptr, Precedence::OR}},
-      {TokenType::AND, {nullptr, nullptr, Precedence::AND}},
-      {TokenType::TRUE,
-       {bindMethod(&Parser::parseLiteral), nullptr, Precedence::NONE}},
-      {TokenType::FALSE,
-       {bindMethod(&Parser::parseLiteral), nullptr, Precedence::NONE}},
-      {TokenType::NUL,
-       {bindMethod(&Parser::parseLiteral), nullptr, Precedence::NONE}},
-      {TokenType::THIS, {nullptr, nullptr, Precedence::NONE}},
-
-      {TokenType::ERROR, {nullptr, nullptr, Precedence::NONE}},
-      {TokenType::TEOF, {nullptr, nullptr, Precedence::NONE}},
-  };
-};
+Parser::Parser() : Parser(std::make_shared<GlobalTable>()) {
+}
+
+Parser::Parser(std::shared_ptr<GlobalTable> globals)
+    : globals(std::move(globals)) {
+}
+
+// Token types without an entry get no prefix or infix rule and
+// Precedence::NONE.
+constexpr std::array<ParseRule,
+                     static_cast<std::size_t>(TokenType::TOKEN_COUNT)>
+    Parser::rules = [] {
+      std::array<ParseRule, static_cast<std::size_t>(TokenType::TOKEN_COUNT)>
+          table{};
+      auto rule = [&table](TokenType type, ParseFn prefix, ParseFn infix,
+                           Precedence precedence) {
+        table[static_cast<std::size_t>(type)] = {prefix, infix, precedence};
+      };
+
+      rule(TokenType::LEFT_PAREN, &Parser::parseGroup, nullptr,
+           Precedence::NONE);
+      rule(TokenType::MINUS, &Parser::parseUnaryExpr, &Parser::parseBinaryExpr,
+           Precedence::TERM);
+      rule(TokenType::PLUS, nullptr, &Parser::parseBinaryExpr,
+           Precedence::TERM);
+      rule(TokenType::SLASH, nullptr, &Parser::parseBinaryExpr,
+           Precedence::FACTOR);
+      rule(TokenType::STAR, nullptr, &Parser::parseBinaryExpr,
+           Precedence::FACTOR);
+
+      rule(TokenType::BANG, &Parser::parseUnaryExpr, nullptr,
+           Precedence::NONE);
+      rule(TokenType::BANG_EQUAL, nullptr, &Parser::parseBinaryExpr,
+           Precedence::EQUALITY);
+      rule(TokenType::EQUAL_EQUAL, nullptr, &Parser::parseBinaryExpr,
+           Precedence::EQUALITY);
+      rule(TokenType::GREATER, nullptr, &Parser::parseBinaryExpr,
+           Precedence::COMPARISON);
+      rule(TokenType::GREATER_EQUAL, nullptr, &Parser::parseBinaryExpr,
+           Precedence::COMPARISON);
+      rule(TokenType::LESS, nullptr, &Parser::parseBinaryExpr,
+           Precedence::COMPARISON);
+      rule(TokenType::LESS_EQUAL, nullptr, &Parser::parseBinaryExpr,
+           Precedence::COMPARISON);
+
+      rule(TokenType::IDENTIFIER, &Parser::var, nullptr, Precedence::NONE);
+      rule(TokenType::STRING, &Parser::parseString, nullptr, Precedence::NONE);
+      rule(TokenType::INTEGER, &Parser::parseNumber, nullptr,
+           Precedence::NONE);
+      rule(TokenType::DOUBLE, &Parser::parseNumber, nullptr, Precedence::NONE);
+
+      rule(TokenType::OR, nullptr, nullptr, Precedence::OR);
+      rule(TokenType::AND, nullptr, nullptr, Precedence::AND);
+      rule(TokenType::TRUE, &Parser::parseLiteral, nullptr, Precedence::NONE);
+      rule(TokenType::FALSE, &Parser::parseLiteral, nullptr, Precedence::NONE);
+      rule(TokenType::NUL, &Parser::parseLiteral, nullptr, Precedence::NONE);
+      return table;
+    }();
+
+static StaticType declaredType(TokenType declType) {
+  switch (declType) {
+    case TokenType::LET_INTEGER:
+      return StaticType::INT;
+    case TokenType::LET_DOUBLE:
+      return StaticType::DOUBLE;
+    case TokenType::LET_STRING:
+      return StaticType::STRING;
+    case TokenType::LET_BOOL:
+      return StaticType::BOOL;
+    default:
+      return StaticType::UNKNOWN;
+  }
+}
+
+static bool isNumeric(StaticType type) {
+  return type == StaticType::INT || type == StaticType::DOUBLE;
+}
+
+static std::optional<OpCode> genericBinaryOp(TokenType opType) {
+  switch (opType) {
+    case TokenType::PLUS:
+      return OpCode::ADD;
+    case TokenType::MINUS:
+      return OpCode::SUBTRACT;
+    case TokenType::STAR:
+      return OpCode::MULTIPLY;
+    case TokenType::SLASH:
+      return OpCode::DIVIDE;
+    case TokenType::BANG_EQUAL:
+      return OpCode::NOT_EQUAL;
+    case TokenType::EQUAL_EQUAL:
+      return OpCode::EQUAL;
+    case TokenType::GREATER:
+      return OpCode::GREATER;
+    case TokenType::GREATER_EQUAL:
+      return OpCode::GREATER_EQUAL;
+    case TokenType::LESS:
+      return OpCode::LESS;
+    case TokenType::LESS_EQUAL:
+      return OpCode::LESS_EQUAL;
+    default:
+      return std::nullopt;
+  }
+}
+
+static std::optional<OpCode> specializedBinaryOp(TokenType opType,
+                                                 StaticType a, StaticType b) {
+  if (a == StaticType::STRING && b == StaticType::STRING &&
+      opType == TokenType::PLUS) {
+    return OpCode::CONCAT_STR;
+  } else if (a != b || !isNumeric(a)) {
+    return std::nullopt;
+  }
+
+  bool ints = a == StaticType::INT;
+  switch (opType) {
+    case TokenType::PLUS:
+      return ints ? OpCode::ADD_INT : OpCode::ADD_DOUBLE;
+    case TokenType::MINUS:
+      return ints ? OpCode::SUBTRACT_INT : OpCode::SUBTRACT_DOUBLE;
+    case TokenType::STAR:
+      return ints ? OpCode::MULTIPLY_INT : OpCode::MULTIPLY_DOUBLE;
+    case TokenType::SLASH:
+      return ints ? OpCode::DIVIDE_INT : OpCode::DIVIDE_DOUBLE;
+    case TokenType::GREATER:
+      return ints ? OpCode::GREATER_INT : OpCode::GREATER_DOUBLE;
+    case TokenType::GREATER_EQUAL:
+      return ints ? OpCode::GREATER_EQUAL_INT : OpCode::GREATER_EQUAL_DOUBLE;
+    case TokenType::LESS:
+      return ints ? OpCode::LESS_INT : OpCode::LESS_DOUBLE;
+    case TokenType::LESS_EQUAL:
+      return ints ? OpCode::LESS_EQUAL_INT : OpCode::LESS_EQUAL_DOUBLE;
+    default:
+      return std::nullopt;
+  }
+}
 
 const ParseRule& Parser::getRule(TokenType type) {
-  return rules.at(type);
+  return rules[static_cast<std::size_t>(type)];
 }
 
 void Parser::parseDecl() {
@@ -109,12 +164,15 @@ void Parser::var() {
   namedVar(previous);
 }
 
-void Parser::namedVar(const std::unique_ptr<Token>& token) {
-  std::size_t arg = identifierConst(token);
-  if (match(TokenType::EQUAL)) {
-    emitVariableByte(OpCode::SET_GLOBAL, OpCode::SET_GLOBAL_LONG, arg);
+void Parser::namedVar(std::size_t token) {
+  std::size_t slot = resolveGlobal(token);
+  if (canAssign && match(TokenType::EQUAL)) {
+    parseExpr();
+    checkStore(slot);
+    emitVariableByte(OpCode::SET_GLOBAL, OpCode::SET_GLOBAL_LONG, slot);
   } else {
-    emitVariableByte(OpCode::GET_GLOBAL, OpCode::GET_GLOBAL_LONG, arg);
+    emitVariableByte(OpCode::GET_GLOBAL, OpCode::GET_GLOBAL_LONG, slot);
+    lastType = globals->getType(slot);
   }
 }
 
@@ -125,42 +183,86 @@ bool Parser::isVarDecl() {
 }
 
 void Parser::parseVarDecl() {
-  bool deducible = !checkPrev(TokenType::LET);
+  TokenType declType = tokens[previous].type;
+  bool deducible = declType != TokenType::LET;
   auto globalVar = parseVar("Expect variable name");
+  declareGlobal(globalVar, declaredType(declType));
 
   if (match(TokenType::EQUAL)) {
     parseExpr();
   } else if (deducible) {
-    emitDefaultVarValue();
+    emitDefaultVarValue(declType);
   } else {
-    errorAtCurrent("Declaration of variable '" + std::string(current->lexeme) +
+    errorAtCurrent("Declaration of variable '" +
+                   std::string(tokens.lexeme(current)) +
                    "' with deduce type 'let' requires an initializer.");
   }
 
+  checkStore(globalVar);
   defineVar(globalVar);
+  consumeStmtEnd("Expect ';' after variable declaration.");
 }
 
 std::size_t Parser::parseVar(std::string_view errorMessage) {
   consume(TokenType::IDENTIFIER, errorMessage);
-  return identifierConst(previous);
+  return resolveGlobal(previous);
 }
 
-std::size_t Parser::identifierConst(const std::unique_ptr<Token>& token) {
-  ObjString* name = getOrIntern(token->lexeme);
-  return compilingCode()->createConstant(name);
+std::size_t Parser::resolveGlobal(std::size_t token) {
+  ObjString* name = getOrIntern(tokens.lexeme(token));
+  return globals->resolve(name);
 }
 
-void Parser::defineVar(std::size_t globalAddress) {
+void Parser::defineVar(std::size_t globalSlot) {
   emitVariableByte(OpCode::DEFINE_GLOBAL, OpCode::DEFINE_GLOBAL_LONG,
-                   globalAddress);
+                   globalSlot);
+}
+
+void Parser::declareGlobal(std::size_t slot, StaticType type) {
+  std::optional<StaticType> declared = globals->getDeclaredType(slot);
+  if (!declared) {
+    globals->declare(slot, type);
+    declaredSlots.push_back(slot);
+  } else if (*declared != type) {
+    error("Variable '" + globals->getName(slot)->toString() +
+          "' is already declared as " + staticTypeName(*declared) + ".");
+  }
+}
+
+// Values stored into a typed global must match its declared type, with ints
+// widening to doubles. Values whose type is unknown are checked at runtime.
+void Parser::checkStore(std::size_t slot) {
+  StaticType declared = globals->getType(slot);
+  if (declared == StaticType::UNKNOWN || lastType == declared) {
+    return;
+  }
+
+  bool widening =
+      lastType == StaticType::INT && declared == StaticType::DOUBLE;
+  if (!widening && lastType != StaticType::UNKNOWN) {
+    error(std::string("Cannot assign a value of type ") +
+          staticTypeName(lastType) + " to '" +
+          globals->getName(slot)->toString() + "' of type " +
+          staticTypeName(declared) + ".");
+  }
+
+  auto constant = trailingConstant();
+  if (widening && constant) {
+    compilingCode()->truncate(constant->start);
+    emitValue(coerce(constant->value, declared).value);
+  } else {
+    emitByte(OpCode::COERCE);
+    emitByte(static_cast<uint8_t>(declared));
+  }
+  lastType = declared;
 }
 
-void Parser::emitDefaultVarValue() {
-  if (checkPrev(TokenType::LET_BOOL)) {
-    emitByte(OpCode::FALSE);
-  } else if (checkPrev(TokenType::LET_INTEGER)) {
+void Parser::emitDefaultVarValue(TokenType declType) {
+  if (declType == TokenType::LET_BOOL) {
+    emitValue(false);
+  } else if (declType == TokenType::LET_INTEGER) {
     emitConstant(0);
-  } else if (checkPrev(TokenType::LET_DOUBLE)) {
+  } else if (declType == TokenType::LET_DOUBLE) {
     emitConstant(0.0);
   } else {
     ObjString* emptyString = getOrIntern("");
@@ -169,12 +271,12 @@ void Parser::emitDefaultVarValue() {
 }
 
 void Parser::parseStmt() {
-  parseExpr();
+  parseExprStmt();
 }
 
 void Parser::parseExprStmt() {
   parseExpr();
-  consume(TokenType::SEMICOLON, "Expect ';' after expression.");
+  consumeStmtEnd("Expect ';' after expression.");
   emitByte(OpCode::POP);
 }
 
@@ -188,69 +290,56 @@ void Parser::parseGroup() {
 }
 
 void Parser::parseBinaryExpr() {
-  TokenType opType = previous->type;
+  TokenType opType = tokens[previous].type;
+  auto lhs = trailingConstant();
+  StaticType lhsType = lastType;
   const auto& rule = getRule(opType);
   parsePrecedence(
       static_cast<Precedence>(static_cast<size_t>(rule.precedence) + 1));
+  StaticType rhsType = lastType;
 
-  switch (opType) {
-    case TokenType::PLUS: {
-      emitByte(OpCode::ADD);
-      break;
-    }
-    case TokenType::MINUS: {
-      emitByte(OpCode::SUBTRACT);
-      break;
-    }
-    case TokenType::STAR: {
-      emitByte(OpCode::MULTIPLY);
-      break;
-    }
-    case TokenType::SLASH: {
-      emitByte(OpCode::DIVIDE);
-      break;
-    }
-    case TokenType::BANG_EQUAL: {
-      emitByte(OpCode::NOT_EQUAL);
-      break;
-    }
-    case TokenType::EQUAL_EQUAL: {
-      emitByte(OpCode::EQUAL);
-      break;
-    }
-    case TokenType::GREATER: {
-      emitByte(OpCode::GREATER);
-      break;
-    }
-    case TokenType::GREATER_EQUAL: {
-      emitByte(OpCode::GREATER_EQUAL);
-      break;
-    }
-    case TokenType::LESS: {
-      emitByte(OpCode::LESS);
-      break;
-    }
-    case TokenType::LESS_EQUAL: {
-      emitByte(OpCode::LESS_EQUAL);
-      break;
-    }
-    default:
-      return;
+  if (lhs && foldBinary(opType, *lhs)) {
+    return;
+  }
+
+  std::optional<OpCode> generic = genericBinaryOp(opType);
+  if (!generic) {
+    return;
+  }
+
+  lastType = binaryResultType(*generic, lhsType, rhsType);
+  if (auto specialized = specializedBinaryOp(opType, lhsType, rhsType)) {
+    emitByte(*specialized);
+  } else {
+    emitByte(*generic);
   }
 }
 
 void Parser::parseUnaryExpr() {
-  TokenType opType = previous->type;
+  TokenType opType = tokens[previous].type;
 
   parsePrecedence(Precedence::UNARY);
+  StaticType operandType = lastType;
+
+  if (foldUnary(opType)) {
+    return;
+  }
 
   switch (opType) {
     case TokenType::MINUS: {
-      emitByte(OpCode::NEGATE);
+      if (operandType == StaticType::INT) {
+        emitByte(OpCode::NEGATE_INT);
+      } else if (operandType == StaticType::DOUBLE) {
+        emitByte(OpCode::NEGATE_DOUBLE);
+      } else {
+        emitByte(OpCode::NEGATE);
+        lastType = StaticType::UNKNOWN;
+      }
       break;
     }
     case TokenType::BANG: {
       emitByte(OpCode::NOT);
+      lastType = StaticType::BOOL;
       break;
     }
     default: {
@@ -260,29 +349,29 @@ void Parser::parseUnaryExpr() {
 }
 
 void Parser::parseNumber() {
-  if (previous->type != TokenType::INTEGER &&
-      previous->type != TokenType::DOUBLE) {
+  if (tokens[previous].type != TokenType::INTEGER &&
+      tokens[previous].type != TokenType::DOUBLE) {
     error("Invalid numeric literal.");
   }
-  emitConstant(previous->literal.value());
+  emitConstant(tokens.literal(previous));
 }
 
 void Parser::parseString() {
-  emitConstant(previous->literal.value());
+  emitConstant(tokens.literal(previous));
 }
 
 void Parser::parseLiteral() {
-  switch (previous->type) {
+  switch (tokens[previous].type) {
     case TokenType::FALSE: {
-      emitByte(OpCode::FALSE);
+      emitValue(false);
       break;
     }
     case TokenType::TRUE: {
-      emitByte(OpCode::TRUE);
+      emitValue(true);
       break;
     }
     case TokenType::NUL: {
-      emitByte(OpCode::NUL);
+      emitValue(Null{});
       break;
     }
     default: {
@@ -303,35 +392,139 @@ void Parser::emitVariableByte(OpCode shortCode, OpCode longCode,
 }
 
 void Parser::emitByte(OpCode byte) {
-  compilingCode()->putOpCode(byte, previous->line);
+  compilingCode()->putOpCode(byte, tokens[previous].line);
 }
 
 void Parser::emitConstant(const Type& value) {
-  compilingCode()->putConstant(value, previous->line);
+  std::size_t start = compilingCode()->count();
+  compilingCode()->putConstant(value, tokens[previous].line);
+  lastConstant = FoldableConstant{start, compilingCode()->count(), value};
+  lastType = staticTypeOf(value);
+}
+
+void Parser::emitValue(const Type& value) {
+  if (!isBool(value) && !isNull(value)) {
+    emitConstant(value);
+    return;
+  }
+
+  std::size_t start = compilingCode()->count();
+  if (isNull(value)) {
+    emitByte(OpCode::NUL);
+  } else {
+    emitByte(asBool(value) ? OpCode::TRUE : OpCode::FALSE);
+  }
+  lastConstant = FoldableConstant{start, compilingCode()->count(), value};
+  lastType = staticTypeOf(value);
+}
+
+std::optional<Parser::FoldableConstant> Parser::trailingConstant() {
+  if (lastConstant && lastConstant->end == compilingCode()->count()) {
+    return lastConstant;
+  }
+  return std::nullopt;
+}
+
+bool Parser::foldBinary(TokenType opType, const FoldableConstant& lhs) {
+  auto rhs = trailingConstant();
+  if (!rhs || rhs->start != lhs.end) {
+    return false;
+  }
+
+  const Type& a = lhs.value;
+  const Type& b = rhs->value;
+  OperationResult result;
+  switch (opType) {
+    case TokenType::PLUS:
+      result = binaryOperation(std::plus<>(), a, b);
+      break;
+    case TokenType::MINUS:
+      result = binaryOperation(std::minus<>(), a, b);
+      break;
+    case TokenType::STAR:
+      result = binaryOperation(std::multiplies<>(), a, b);
+      break;
+    case TokenType::SLASH:
+      result = binaryOperation(std::divides<>(), a, b);
+      break;
+    case TokenType::GREATER:
+      result = binaryOperation(std::greater<>(), a, b);
+      break;
+    case TokenType::GREATER_EQUAL:
+      result = binaryOperation(std::greater_equal<>(), a, b);
+      break;
+    case TokenType::LESS:
+      result = binaryOperation(std::less<>(), a, b);
+      break;
+    case TokenType::LESS_EQUAL:
+      result = binaryOperation(std::less_equal<>(), a, b);
+      break;
+    case TokenType::EQUAL_EQUAL:
+      result.value = valuesEqual(a, b);
+      break;
+    case TokenType::BANG_EQUAL:
+      result.value = !valuesEqual(a, b);
+      break;
+    default:
+      return false;
+  }
+
+  if (result.error) {
+    error(result.error);
+  }
+
+  compilingCode()->truncate(lhs.start);
+  emitValue(result.value);
+  return true;
+}
+
+bool Parser::foldUnary(TokenType opType) {
+  auto operand = trailingConstant();
+  if (!operand) {
+    return false;
+  }
+
+  OperationResult result;
+  switch (opType) {
+    case TokenType::MINUS:
+      result = negate(operand->value);
+      break;
+    case TokenType::BANG:
+      result = logicalNot(operand->value);
+      break;
+    default:
+      return false;
+  }
+
+  if (result.error) {
+    error(result.error);
+  }
+
+  compilingCode()->truncate(operand->start);
+  emitValue(result.value);
+  return true;
 }
 
 void Parser::emitByte(uint8_t byte) {
-  compilingCode()->putRaw(byte, previous->line);
+  compilingCode()->putRaw(byte, tokens[previous].line);
 }
 
 void Parser::emitByte(std::size_t byte) {
-  compilingCode()->putRaw(byte, previous->line);
+  compilingCode()->putRaw(byte, tokens[previous].line);
 }
 
 std::shared_ptr<Bytecode> Parser::compilingCode() {
   return compilingBytecode;
 }
 
+// Past the end the parser keeps seeing the final TEOF token.
 void Parser::next() {
-  previous = std::move(current);
-
-  while (true) {
-    current = std::make_unique<Token>(tokenizer->scanToken());
-    if (current->type != TokenType::ERROR) {
-      break;
-    }
+  previous = current;
+  current = std::min(cursor, tokens.size() - 1);
+  cursor = current + 1;
 
-    errorAtCurrent(current->lexeme);
+  if (tokens[current].type == TokenType::ERROR) {
+    errorAtCurrent(tokens.error(current));
   }
 }
 
@@ -344,15 +537,15 @@ bool Parser::match(TokenType type) {
 }
 
 bool Parser::checkCurrent(TokenType type) {
-  return current->type == type;
+  return tokens[current].type == type;
 }
 
 bool Parser::checkPrev(TokenType type) {
-  return previous->type == type;
+  return tokens[previous].type == type;
 }
 
 void Parser::consume(TokenType type, std::string_view message) {
-  if (current->type == type) {
+  if (tokens[current].type == type) {
     next();
     return;
   }
@@ -360,6 +553,14 @@ void Parser::consume(TokenType type, std::string_view message) {
   errorAtCurrent(message);
 }
 
+void Parser::consumeStmtEnd(std::string_view message) {
+  if (checkCurrent(TokenType::TEOF)) {
+    return;
+  }
+
+  consume(TokenType::SEMICOLON, message);
+}
+
 void Parser::synchronize() {
   try {
     next();
@@ -369,7 +570,7 @@ void Parser::synchronize() {
   while (!checkCurrent(TokenType::TEOF)) {
     if (checkPrev(TokenType::SEMICOLON)) return;
 
-    switch (current->type) {
+    switch (tokens[current].type) {
       case TokenType::STRUCT:
       case TokenType::FN:
       case TokenType::LET:
@@ -398,26 +599,26 @@ bool Parser::hadError() {
 }
 
 void Parser::errorAtCurrent(std::string_view message) {
-  errorAt(previous.get(), message);
+  errorAt(previous, message);
 }
 
 void Parser::error(std::string_view message) {
-  errorAt(previous.get(), message);
+  errorAt(previous, message);
 }
 
-void Parser::errorAt(const Token* token, std::string_view message) {
+void Parser::errorAt(std::size_t token, std::string_view message) {
   std::ostringstream errorMsg;
   errorMsg << "Error";
 
-  if (token->type == TokenType::TEOF) {
+  if (tokens[token].type == TokenType::TEOF) {
     errorMsg << " at end";
-  } else if (token->type == TokenType::ERROR) {
+  } else if (tokens[token].type == TokenType::ERROR) {
   } else {
-    errorMsg << " at '" << token->lexeme << "'";
+    errorMsg << " at '" << tokens.lexeme(token) << "'";
   }
 
   errorMsg << ": " << message;
-  throw ParseError(token->line, errorMsg.str());
+  throw ParseError(tokens[token].line, errorMsg.str());
 }
 
 void Parser::emitReturn() {
@@ -426,36 +627,53 @@ void Parser::emitReturn() {
 
 void Parser::endParse() {
   emitReturn();
-#ifdef DEBUG_PRINT_CODE
-  if (!errored) {
-    disassembleBytecode(*compilingCode(), "code");
+  if (optimize && !errored) {
+    optimizeBytecode(*compilingCode());
   }
-#endif
 }
 
 void Parser::parsePrecedence(Precedence precedence) {
   next();
-  ParseFn prefixRule = getRule(previous->type).prefix;
+  ParseFn prefixRule = getRule(tokens[previous].type).prefix;
 
   if (prefixRule == nullptr) {
     error("Expect expression.");
     return;
   }
 
-  prefixRule();
+  bool assignable = precedence <= Precedence::ASSIGNMENT;
+  canAssign = assignable;
+  (this->*prefixRule)();
 
-  while (precedence <= getRule(current->type).precedence) {
+  while (precedence <= getRule(tokens[current].type).precedence) {
     next();
-    ParseFn infixRule = getRule(previous->type).infix;
-    infixRule();
+    ParseFn infixRule = getRule(tokens[previous].type).infix;
+    if (infixRule == nullptr) {
+      // Operators such as `or` have a precedence before they have a rule.
+      error("Unsupported operator.");
+      return;
+    }
+    (this->*infixRule)();
+  }
+
+  if (assignable && match(TokenType::EQUAL)) {
+    error("Invalid assignment target.");
   }
 }
 
+void Parser::setOptimize(bool enabled) {
+  optimize = enabled;
+}
+
 bool Parser::parse(std::string_view sourceCode,
                    std::shared_ptr<Bytecode> bytecode) {
   errored = false;
-  tokenizer = std::make_unique<Tokenizer>(sourceCode);
+  lastConstant = std::nullopt;
+  declaredSlots.clear();
+  Tokenizer(sourceCode).scanAll(tokens);
+  cursor = current = previous = 0;
   this->compilingBytecode = bytecode;
+  bytecode->setGlobals(globals);
 
   while (true) {
     try {
@@ -470,11 +688,18 @@ bool Parser::parse(std::string_view sourceCode,
     } catch (const InterpreterError& ex) {
       errored = true;
       std::cerr << ex.what() << "\n";
-      if (current && current->type == TokenType::TEOF) {
+      if (tokens[current].type == TokenType::TEOF) {
         break;
       }
       synchronize();
     }
   }
+
+  // Declarations of a chunk that never runs must not constrain later code.
+  if (hadError()) {
+    for (std::size_t slot : declaredSlots) {
+      globals->undeclare(slot);
+    }
+  }
   return !hadError();
 }
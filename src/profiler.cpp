@@ -0,0 +1,87 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <utility>
+
+const char* Profiler::timeUnit() {
+#if defined(__x86_64__) || defined(__i386__)
+  return "ticks";
+#else
+  return "ns";
+#endif
+}
+
+void Profiler::startRun(Bytecode& bytecode) {
+  offsetCounts.assign(bytecode.count(), 0);
+  inInstruction = false;
+}
+
+void Profiler::finishRun(Bytecode& bytecode) {
+  if (inInstruction) {
+    opCodes[currentOpCode].ticks += now() - currentStart;
+    inInstruction = false;
+  }
+
+  for (std::size_t offset = 0; offset < offsetCounts.size(); offset++) {
+    if (offsetCounts[offset] > 0) {
+      lineCounts[bytecode.getLine(offset)] += offsetCounts[offset];
+    }
+  }
+  offsetCounts.clear();
+}
+
+uint64_t Profiler::getCount(OpCode opCode) const {
+  return opCodes[static_cast<std::size_t>(opCode)].count;
+}
+
+uint64_t Profiler::getLineCount(uint32_t line) const {
+  auto it = lineCounts.find(line);
+  return it == lineCounts.end() ? 0 : it->second;
+}
+
+void Profiler::report(std::ostream& out, std::size_t maxLines) const {
+  uint64_t totalTicks = 0;
+  std::vector<std::size_t> executed;
+  for (std::size_t i = 0; i < opCodes.size(); i++) {
+    totalTicks += opCodes[i].ticks;
+    if (opCodes[i].count > 0) {
+      executed.push_back(i);
+    }
+  }
+  std::sort(executed.begin(), executed.end(), [&](std::size_t a, std::size_t b) {
+    return opCodes[a].ticks > opCodes[b].ticks;
+  });
+
+  out << "== opcode profile ==\n";
+  out << std::left << std::setw(28) << "opcode" << std::right << std::setw(14)
+      << "count" << std::setw(16) << timeUnit() << std::setw(10) << "time %"
+      << std::setw(14) << "per exec" << "\n";
+  for (std::size_t i : executed) {
+    const OpCodeStats& stats = opCodes[i];
+    double share = totalTicks ? 100.0 * stats.ticks / totalTicks : 0.0;
+    out << std::left << std::setw(28) << opCodeName(static_cast<OpCode>(i))
+        << std::right << std::setw(14) << stats.count << std::setw(16)
+        << stats.ticks << std::setw(9) << std::fixed << std::setprecision(1)
+        << share << "%" << std::setw(14) << std::setprecision(1)
+        << static_cast<double>(stats.ticks) / stats.count << "\n";
+  }
+
+  std::vector<std::pair<uint32_t, uint64_t>> lines(lineCounts.begin(),
+                                                   lineCounts.end());
+  std::sort(lines.begin(), lines.end(), [](const auto& a, const auto& b) {
+    return a.second != b.second ? a.second > b.second : a.first < b.first;
+  });
+  if (lines.size() > maxLines) {
+    lines.resize(maxLines);
+  }
+
+  out << "== line profile ==\n";
+  out << std::left << std::setw(10) << "line" << std::right << std::setw(14)
+      << "executions" << "\n";
+  for (const auto& [line, count] : lines) {
+    out << std::left << std::setw(10) << line << std::right << std::setw(14)
+        << count << "\n";
+  }
+  out << std::defaultfloat;
+}
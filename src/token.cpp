@@ -1,6 +1,16 @@
 #include "token.hpp"
 
-std::unordered_map<std::string, TokenType> Token::keywords = {
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
+
+struct Keyword {
+  std::string_view name;
+  TokenType type;
+};
+
+static constexpr Keyword KEYWORDS[] = {
     {"and", TokenType::AND},
     {"bool", TokenType::LET_BOOL},
     {"double", TokenType::LET_DOUBLE},
@@ -24,15 +34,86 @@ std::unordered_map<std::string, TokenType> Token::keywords = {
     {"true", TokenType::TRUE},
 };
 
+static constexpr std::size_t KEYWORD_SLOTS = 64;
+
+static constexpr std::size_t maxKeywordLength() {
+  std::size_t length = 0;
+  for (const Keyword& keyword : KEYWORDS) {
+    length = std::max(length, keyword.name.size());
+  }
+  return length;
+}
+
+static constexpr std::size_t MAX_KEYWORD_LENGTH = maxKeywordLength();
+
+// Hashes a word from its first and last characters and its length. The
+// multipliers are searched at compile time for ones under which no two
+// keywords share a slot, so a lookup is one hash, one table load and at
+// most one comparison.
+struct KeywordHash {
+  std::size_t first = 0;
+  std::size_t last = 0;
+  std::size_t length = 0;
+
+  constexpr std::size_t operator()(std::string_view word) const {
+    return (static_cast<unsigned char>(word.front()) * first +
+            static_cast<unsigned char>(word.back()) * last +
+            word.size() * length) %
+           KEYWORD_SLOTS;
+  }
+};
+
+static constexpr bool isPerfect(KeywordHash hash) {
+  bool used[KEYWORD_SLOTS] = {};
+  for (const Keyword& keyword : KEYWORDS) {
+    std::size_t slot = hash(keyword.name);
+    if (used[slot]) return false;
+    used[slot] = true;
+  }
+  return true;
+}
+
+static constexpr KeywordHash findKeywordHash() {
+  for (std::size_t first = 1; first < 32; first++) {
+    for (std::size_t last = 0; last < 32; last++) {
+      for (std::size_t length = 0; length < 32; length++) {
+        if (isPerfect({first, last, length})) return {first, last, length};
+      }
+    }
+  }
+  return {};
+}
+
+static constexpr KeywordHash KEYWORD_HASH = findKeywordHash();
+static_assert(KEYWORD_HASH.first != 0,
+              "No perfect hash for the keyword set; widen the search");
+
+// Index into KEYWORDS per hash slot, -1 for empty slots.
+static constexpr std::array<int8_t, KEYWORD_SLOTS> buildKeywordTable() {
+  std::array<int8_t, KEYWORD_SLOTS> table{};
+  table.fill(-1);
+  for (std::size_t i = 0; i < std::size(KEYWORDS); i++) {
+    table[KEYWORD_HASH(KEYWORDS[i].name)] = static_cast<int8_t>(i);
+  }
+  return table;
+}
+
+static constexpr std::array<int8_t, KEYWORD_SLOTS> KEYWORD_TABLE =
+    buildKeywordTable();
+
 Token::Token(int line, TokenType type, std::string_view lexeme,
              std::optional<Type> literal)
     : type(type), lexeme(lexeme), literal(literal), line(line) {
 }
 
 Token Token::lookup(std::string_view lexeme, int line) {
-  auto keywordType = keywords.find(std::string(lexeme));
-  if (keywordType != keywords.end()) {
-    switch (keywordType->second) {
+  if (lexeme.empty() || lexeme.size() > MAX_KEYWORD_LENGTH) {
+    return Token(line, TokenType::IDENTIFIER, lexeme);
+  }
+
+  int8_t index = KEYWORD_TABLE[KEYWORD_HASH(lexeme)];
+  if (index >= 0 && KEYWORDS[index].name == lexeme) {
+    switch (KEYWORDS[index].type) {
       case TokenType::TRUE:
         return Token(line, TokenType::TRUE, lexeme,
                      std::make_optional<Type>(true));
@@ -40,7 +121,7 @@ Token Token::lookup(std::string_view lexeme, int line) {
         return Token(line, TokenType::FALSE, lexeme,
                      std::make_optional<Type>(false));
       default:
-        return Token(line, keywordType->second, lexeme);
+        return Token(line, KEYWORDS[index].type, lexeme);
     }
   }
   return Token(line, TokenType::IDENTIFIER, lexeme);
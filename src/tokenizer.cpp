@@ -6,6 +6,7 @@
 #include <string_view>
 
 #include "allocator.hpp"
+#include "char_scan.hpp"
 #include "interned_strings.hpp"
 #include "token.hpp"
 
@@ -63,7 +64,7 @@ Token Tokenizer::makeToken(TokenType type, std::string_view lexeme,
   return Token(line, type, lexeme, literal);
 }
 
-Token Tokenizer::errorToken(const std::string& msg) {
+Token Tokenizer::errorToken(std::string_view msg) {
   return Token(line, TokenType::ERROR, msg);
 }
 
@@ -87,11 +88,12 @@ bool Tokenizer::match(char expected) {
 }
 
 char Tokenizer::peek() {
+  if (isAtEnd()) return '\0';
   return source[current];
 }
 
 char Tokenizer::peekNext() {
-  if (isAtEnd()) return '\0';
+  if (current + 1 >= source.size()) return '\0';
   return source[current + 1];
 }
 
@@ -113,12 +115,9 @@ bool Tokenizer::shouldInsertSemicolon() {
 }
 
 Token Tokenizer::string() {
-  while (peek() != '"' && !isAtEnd()) {
-    if (peek() == '\n') {
-      line++;
-    }
-    next();
-  }
+  std::size_t newlines = 0;
+  current = scanUntil(source.data(), current, source.size(), '"', newlines);
+  line += newlines;
 
   if (isAtEnd()) {
     return errorToken("Unterminated string.");
@@ -160,53 +159,65 @@ Token Tokenizer::number() {
 }
 
 Token Tokenizer::identifier() {
-  while (isAlpha(peek()) || isDigit(peek())) {
-    next();
-  }
+  current = scanIdentifier(source.data(), current, source.size());
 
   std::string_view lexeme = source.substr(start, current - start);
   return Token::lookup(lexeme, line);
 }
 
 void Tokenizer::skipWhitespace() {
+  const char* data = source.data();
+  std::size_t size = source.size();
+
   for (;;) {
-    char c = peek();
+    // A newline after a token that can end a statement is itself a token,
+    // so newlines are only skipped in bulk when no semicolon is pending.
+    if (insertSemicolon) {
+      current = scanBlanks(data, current, size);
+    } else {
+      std::size_t newlines = 0;
+      current = scanWhitespace(data, current, size, newlines);
+      line += newlines;
+    }
 
-    switch (c) {
-      case ' ':
-      case '\t':
-      case '\r':
-        next();
-        break;
+    switch (peek()) {
       case '\n':
         line++;
-        if (insertSemicolon) {
-          return;
-        }
-        next();
-        break;
+        return;
       case '/':
         if (peekNext() == '/') {
-          while (peek() != '\n' && !isAtEnd()) {
-            next();
-          }
+          std::size_t newlines = 0;
+          current = scanUntil(data, current + 2, size, '\n', newlines);
         } else if (peekNext() == '*') {
-          next();
-          next();
-          while (!(peek() == '*' && peekNext() == '/') && !isAtEnd()) {
-            if (peek() == '\n') {
-              line++;
-            }
-            next();
-          }
+          skipBlockComment();
+        } else {
+          return;
         }
-        return;
+        break;
       default:
         return;
     }
   }
 }
 
+void Tokenizer::skipBlockComment() {
+  const char* data = source.data();
+  std::size_t size = source.size();
+  std::size_t newlines = 0;
+
+  current += 2;
+  while (true) {
+    current = scanUntil(data, current, size, '*', newlines);
+    if (isAtEnd()) break;
+    current++;
+    if (peek() == '/') {
+      current++;
+      break;
+    }
+  }
+  line += newlines;
+}
+
 Token Tokenizer::scanToken() {
   skipWhitespace();
 
@@ -290,3 +301,38 @@ Token Tokenizer::scanToken() {
 
   return errorToken("Unexpected character.");
 }
+
+void Tokenizer::scanAll(TokenBuffer& buffer) {
+  buffer.clear();
+  buffer.source = source;
+  const char* base = source.data();
+
+  while (true) {
+    PackedToken packed{0, 0, 0, 0, TokenType::ERROR};
+    try {
+      Token token = scanToken();
+      packed.type = token.type;
+      packed.line = static_cast<uint32_t>(token.line);
+      if (token.type == TokenType::ERROR) {
+        packed.extra = static_cast<uint32_t>(buffer.errors.size());
+        buffer.errors.emplace_back(token.lexeme);
+      } else {
+        packed.offset = static_cast<uint32_t>(token.lexeme.data() - base);
+        packed.length = static_cast<uint32_t>(token.lexeme.size());
+        if (token.literal) {
+          packed.extra = static_cast<uint32_t>(buffer.literals.size());
+          buffer.literals.push_back(*token.literal);
+        }
+      }
+    } catch (const ScanError& ex) {
+      packed.line = ex.getLine();
+      packed.extra = static_cast<uint32_t>(buffer.errors.size());
+      buffer.errors.push_back(ex.getMessage());
+    }
+
+    buffer.tokens.push_back(packed);
+    if (packed.type == TokenType::TEOF) {
+      return;
+    }
+  }
+}
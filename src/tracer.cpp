@@ -0,0 +1,77 @@
+#include "tracer.hpp"
+
+std::optional<unsigned> Tracer::parseFlags(std::string_view list) {
+  unsigned flags = 0;
+  while (!list.empty()) {
+    std::size_t comma = list.find(',');
+    std::string_view name = list.substr(0, comma);
+
+    if (name == "ops") {
+      flags |= OPS;
+    } else if (name == "stack") {
+      flags |= STACK;
+    } else if (name == "code") {
+      flags |= CODE;
+    } else if (name == "all") {
+      flags |= ALL;
+    } else {
+      return std::nullopt;
+    }
+
+    if (comma == std::string_view::npos) break;
+    list.remove_prefix(comma + 1);
+  }
+  return flags;
+}
+
+Tracer::Tracer(unsigned flags, std::ostream& target)
+    : flags(flags), buffer(target.rdbuf()), stream(&buffer) {
+}
+
+Tracer::Tracer(unsigned flags, std::unique_ptr<std::ofstream> file)
+    : flags(flags),
+      file(std::move(file)),
+      buffer(this->file->rdbuf()),
+      stream(&buffer) {
+}
+
+std::unique_ptr<Tracer> Tracer::toFile(unsigned flags,
+                                       const std::string& path) {
+  auto file = std::make_unique<std::ofstream>(path, std::ios::binary);
+  if (!*file) {
+    return nullptr;
+  }
+  return std::unique_ptr<Tracer>(new Tracer(flags, std::move(file)));
+}
+
+Tracer::~Tracer() {
+  flush();
+}
+
+void Tracer::flush() {
+  stream.flush();
+}
+
+Tracer::Buffer::Buffer(std::streambuf* target) : target(target), data(SIZE) {
+  setp(data.data(), data.data() + data.size());
+}
+
+Tracer::Buffer::int_type Tracer::Buffer::overflow(int_type ch) {
+  if (sync() != 0) {
+    return traits_type::eof();
+  }
+  if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
+  }
+  return traits_type::not_eof(ch);
+}
+
+int Tracer::Buffer::sync() {
+  std::streamsize pending = pptr() - pbase();
+  if (pending > 0 && target->sputn(pbase(), pending) != pending) {
+    return -1;
+  }
+  setp(data.data(), data.data() + data.size());
+  return target->pubsync();
+}
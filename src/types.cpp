@@ -1,33 +1,30 @@
 #include "types.hpp"
 
-void printObject(const Object* value) {
+static void printObject(const Object* value, std::ostream& out) {
   if (value == nullptr) {
-    std::cout << "null object";
+    out << "null object";
     return;
   }
 
   if (auto objString = dynamic_cast<const ObjString*>(value)) {
-    std::cout << "\"" << objString->toString() << "\"";
+    out << "\"" << objString->toString() << "\"";
   } else {
-    std::cout << value->toString();
+    out << value->toString();
   }
 }
 
-void printValue(const Type& value) {
-  std::visit(
-      [](auto&& arg) {
-        using T = std::decay_t<decltype(arg)>;
-        if constexpr (std::is_same_v<T, Null>) {
-          std::cout << "null";
-        } else if constexpr (std::is_same_v<T, bool>) {
-          std::cout << (arg ? "true" : "false");
-        } else if constexpr (std::is_same_v<T, Object*>) {
-          printObject(arg);
-        } else {
-          std::cout << arg;
-        }
-      },
-      value);
+void printValue(const Type& value, std::ostream& out) {
+  if (isNull(value)) {
+    out << "null";
+  } else if (isBool(value)) {
+    out << (asBool(value) ? "true" : "false");
+  } else if (isObject(value)) {
+    printObject(asObject(value), out);
+  } else if (isInt(value)) {
+    out << asInt(value);
+  } else {
+    out << asDouble(value);
+  }
 }
 
 bool isObjType(const Type& value, const std::type_info& type) {
@@ -43,3 +40,36 @@ bool isObjType(const Type& value, const std::type_info& type) {
 ObjString* asString(const Type& value) {
   return dynamic_cast<ObjString*>(asObject(value));
 }
+
+StaticType staticTypeOf(const Type& value) {
+  switch (typeOf(value)) {
+    case ValueType::NUL:
+      return StaticType::NUL;
+    case ValueType::INT:
+      return StaticType::INT;
+    case ValueType::DOUBLE:
+      return StaticType::DOUBLE;
+    case ValueType::BOOL:
+      return StaticType::BOOL;
+    case ValueType::OBJECT:
+      return isString(value) ? StaticType::STRING : StaticType::UNKNOWN;
+  }
+  return StaticType::UNKNOWN;
+}
+
+const char* staticTypeName(StaticType type) {
+  switch (type) {
+    case StaticType::NUL:
+      return "null";
+    case StaticType::INT:
+      return "int";
+    case StaticType::DOUBLE:
+      return "double";
+    case StaticType::BOOL:
+      return "bool";
+    case StaticType::STRING:
+      return "string";
+    default:
+      return "let";
+  }
+}
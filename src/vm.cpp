@@ -3,46 +3,31 @@
 #include <cstdint>
 #include <functional>
 #include <iostream>
+#include <iterator>
 #include <memory>
+#include <optional>
 #include <sstream>
-#include <variant>
 
 #include "bytecode.hpp"
+#include "bytecode_file.hpp"
 #include "debug.hpp"
 #include "dynamic_types.hpp"
 #include "types.hpp"
 
-static bool valuesEqual(Type a, Type b) {
-  if (!isSameType(a, b)) {
-    return false;
+void VM::prepareStack() {
+  const StackDepth& depth = bytecode->stackDepth();
+  if (depth.max > STACK_MAX) {
+    throw RuntimeError(bytecode->getLine(depth.offset), "Stack overflow.");
   }
 
-  return std::visit(
-      [](auto&& argA, auto&& argB) -> bool {
-        using T1 = std::decay_t<decltype(argA)>;
-        using T2 = std::decay_t<decltype(argB)>;
-
-        if constexpr (std::is_same_v<T1, T2>) {
-          if constexpr (std::is_same_v<T1, Null>) {
-            return true;
-          } else {
-            return argA == argB;
-          }
-        } else {
-          return false;
-        }
-      },
-      a, b);
-}
-
-Type VM::pop() {
-  Type stackValue = stack.back();
-  stack.pop_back();
-  return stackValue;
+  if (stack.size() < depth.max) {
+    stack.resize(depth.max);
+  }
+  resetStack();
 }
 
-void VM::push(Type value) {
-  stack.push_back(value);
+void VM::resetStack() {
+  stackTop = stack.data();
 }
 
 std::size_t VM::currentInstructionAddress() {
@@ -50,241 +35,726 @@ std::size_t VM::currentInstructionAddress() {
 }
 
 uint32_t VM::getCurrentLine() {
-  return currentInstructionAddress() - 1;
+  return bytecode->getLine(currentInstructionAddress() - 1);
 }
 
 Type VM::readConstantLong() {
-  uint32_t constantAddr = 0;
-  constantAddr |= readByte();
-  constantAddr |= readByte() << 8;
-  constantAddr |= readByte() << 16;
-  return bytecode->getConstant(constantAddr);
+  return bytecode->readConstant(readSlotLong());
 }
 
-String VM::toString(const Type& value) {
-  return std::visit(
-      [](auto&& arg) -> String {
-        using T = std::decay_t<decltype(arg)>;
-        if constexpr (std::is_same_v<T, ObjString>) {
-          return arg.value;
-        } else if constexpr (std::is_same_v<T, bool>) {
-          return arg ? "true" : "false";
-        } else if constexpr (std::is_same_v<T, Null>) {
-          return "null";
-        } else if constexpr (std::is_same_v<T, int32_t> ||
-                             std::is_same_v<T, double>) {
-          return String(std::to_string(arg).begin(), std::to_string(arg).end(),
-                        Allocator<char>());
-        } else if constexpr (std::is_same_v<T, Object*>) {
-          auto objStr = dynamic_cast<ObjString*>(arg);
-
-          if (objStr) {
-            return objStr->value;
-          }
-          return "object";
-        } else {
-          return "unkown";
-        }
-      },
-      value);
+std::size_t VM::readSlotLong() {
+  std::size_t address = 0;
+  address |= readByte();
+  address |= readByte() << 8;
+  address |= readByte() << 16;
+  return address;
 }
 
-VM::~VM() {
-  for (Object* obj : objects) {
-    if (obj) {
-      destructAndDeallocate(obj);
+void VM::setOptimize(bool enabled) {
+  parser.setOptimize(enabled);
+}
+
+bool VM::enableProfiling() {
+#ifdef ONOL_PROFILER
+  if (!profiler) {
+    profiler = std::make_unique<Profiler>();
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+const Profiler* VM::getProfiler() const {
+  return profiler.get();
+}
+
+void VM::setTracer(std::unique_ptr<Tracer> newTracer) {
+  tracer = std::move(newTracer);
+}
+
+VM::VM() {
+  heap.setRootMarker([this](Heap&) { markRoots(); });
+}
+
+void VM::markRoots() {
+  for (Type* slot = stack.data(); slot < stackTop; slot++) {
+    heap.markValue(*slot);
+  }
+
+  Type* values = globals->getValues();
+  switch (heap.rootScan()) {
+    case Heap::RootScan::YOUNG:
+      for (uint32_t slot : rememberedGlobals) {
+        heap.markValue(values[slot]);
+      }
+      break;
+    case Heap::RootScan::ALL:
+      for (std::size_t slot = 0; slot < globals->count(); slot++) {
+        heap.markValue(values[slot]);
+      }
+      // Constants are never young.
+      if (bytecode) {
+        for (const Type& constant : bytecode->getConstantPool()) {
+          if (isObject(constant)) heap.markObject(asObject(constant));
+        }
+      }
+      break;
+    case Heap::RootScan::STACK:
+      break;
+  }
+
+  // No global is left pointing into the emptied nursery.
+  if (heap.emptyingNursery()) {
+    for (uint32_t slot : rememberedGlobals) {
+      globalCards[slot] = 0;
     }
+    rememberedGlobals.clear();
+  }
+}
+
+void VM::rememberGlobal(std::size_t slot) {
+  if (!globalCards[slot]) {
+    globalCards[slot] = 1;
+    rememberedGlobals.push_back(static_cast<uint32_t>(slot));
+  }
+}
+
+void VM::collectGarbage() {
+  heap.collect();
+}
+
+void VM::setStressGC(bool enabled) {
+  heap.setStressMode(enabled);
+}
+
+void VM::setIncrementalGC(bool enabled, Heap::SliceBudget budget) {
+  heap.setIncremental(enabled, budget);
+}
+
+const Heap& VM::getHeap() const {
+  return heap;
+}
+
+std::shared_ptr<Bytecode> VM::compile(const std::string& sourceCode) {
+  auto chunk = std::make_shared<Bytecode>();
+
+  if (!parser.parse(sourceCode, chunk)) {
+    chunk->free();
+    return nullptr;
+  }
+
+  // Validated here once rather than on every run of the chunk.
+  try {
+    chunk->stackDepth();
+  } catch (const InterpreterError& ex) {
+    std::cerr << ex.what() << "\n";
+    return nullptr;
+  }
+  return chunk;
+}
+
+std::shared_ptr<Bytecode> VM::load(const std::string& path) {
+  try {
+    return loadBytecodeFile(path, globals);
+  } catch (const InterpreterError& ex) {
+    std::cerr << ex.what() << "\n";
+    return nullptr;
   }
-  objects.clear();
-  clearInternedStrings();
 }
 
 InterpretResult VM::interpret(const std::string& sourceCode) {
-  bytecode = std::make_shared<Bytecode>();
+  std::shared_ptr<Bytecode> chunk = compile(sourceCode);
+  if (!chunk) {
+    return InterpretResult::INTERPRET_COMPILE_ERROR;
+  }
+  return interpret(chunk);
+}
 
-  if (!parser.parse(sourceCode, bytecode)) {
-    bytecode->free();
+InterpretResult VM::interpret(std::shared_ptr<Bytecode> chunk) {
+  if (chunk->getGlobals() != globals.get()) {
+    std::cerr << "Bytecode was compiled for a different VM.\n";
     return InterpretResult::INTERPRET_COMPILE_ERROR;
   }
 
+  bytecode = std::move(chunk);
+  bytecode->internLazyStrings();
   ip = bytecode->getCodePointer();
   InterpretResult result;
 
+  if (tracer && tracer->has(Tracer::CODE)) {
+    disassembleBytecode(*bytecode, "code", tracer->out());
+  }
+
   try {
+    prepareStack();
+    globalValues = globals->getValues();
+    globalCards.resize(globals->count());
+    if (profiler) profiler->startRun(*bytecode);
     result = run();
-  } catch (const RuntimeError& ex) {
+  } catch (const InterpreterError& ex) {
+    // Flushed first so the trace ends before the error is reported.
+    if (tracer) tracer->flush();
     std::cerr << ex.what() << "\n";
+    resetStack();
+    result = InterpretResult::INTERPRET_RUNTIME_ERROR;
   }
 
+  if (profiler) profiler->finishRun(*bytecode);
+  if (tracer) tracer->flush();
+
   return result;
 }
 
-Type VM::peek(std::size_t distance) const {
-  return stack[stack.size() - 1 - distance];
+static std::optional<OpCode> quickenedIntForm(OpCode generic) {
+  switch (generic) {
+    case OpCode::ADD:
+      return OpCode::ADD_INT_QUICK;
+    case OpCode::SUBTRACT:
+      return OpCode::SUBTRACT_INT_QUICK;
+    case OpCode::MULTIPLY:
+      return OpCode::MULTIPLY_INT_QUICK;
+    case OpCode::DIVIDE:
+      return OpCode::DIVIDE_INT_QUICK;
+    case OpCode::GREATER:
+      return OpCode::GREATER_INT_QUICK;
+    case OpCode::LESS:
+      return OpCode::LESS_INT_QUICK;
+    case OpCode::GREATER_EQUAL:
+      return OpCode::GREATER_EQUAL_INT_QUICK;
+    case OpCode::LESS_EQUAL:
+      return OpCode::LESS_EQUAL_INT_QUICK;
+    default:
+      return std::nullopt;
+  }
+}
+
+static std::optional<OpCode> quickenedDoubleForm(OpCode generic) {
+  switch (generic) {
+    case OpCode::ADD:
+      return OpCode::ADD_DOUBLE_QUICK;
+    case OpCode::SUBTRACT:
+      return OpCode::SUBTRACT_DOUBLE_QUICK;
+    case OpCode::MULTIPLY:
+      return OpCode::MULTIPLY_DOUBLE_QUICK;
+    case OpCode::DIVIDE:
+      return OpCode::DIVIDE_DOUBLE_QUICK;
+    case OpCode::GREATER:
+      return OpCode::GREATER_DOUBLE_QUICK;
+    case OpCode::LESS:
+      return OpCode::LESS_DOUBLE_QUICK;
+    case OpCode::GREATER_EQUAL:
+      return OpCode::GREATER_EQUAL_DOUBLE_QUICK;
+    case OpCode::LESS_EQUAL:
+      return OpCode::LESS_EQUAL_DOUBLE_QUICK;
+    default:
+      return std::nullopt;
+  }
+}
+
+// Called by a generic binary opcode before it runs: operands of a matching
+// int, double or string pair rewrite the instruction into its quickened form.
+void VM::quickenBinary(OpCode generic) {
+  Type a = peek(1);
+  Type b = peek(0);
+  std::optional<OpCode> quickened;
+
+  if (isInt(a) && isInt(b)) {
+    quickened = quickenedIntForm(generic);
+  } else if (isDouble(a) && isDouble(b)) {
+    quickened = quickenedDoubleForm(generic);
+  } else if (generic == OpCode::ADD && isString(a) && isString(b)) {
+    quickened = OpCode::CONCAT_STR_QUICK;
+  }
+
+  if (quickened) {
+    quicken(ip - 1, *quickened);
+  }
 }
 
-String VM::checkVarExistsAndGetName(Type constName) {
-  ObjString* objName = asString(constName);
-  String varName = objName->value;
+void VM::undefinedVariable(std::size_t slot) {
+  ObjString* name = globals->getName(slot);
+  throw RuntimeError(getCurrentLine(),
+                     "Undefined variable '" + name->toString() + "'.");
+}
 
-  auto it = globals.find(varName);
-  if (it == globals.end()) {
-    auto str = "Undefined variable '" + toStdString(varName) + "'.";
-    throw RuntimeError(getCurrentLine(), str);
+std::optional<Type> VM::getGlobal(std::string_view name) {
+  auto slot = globals->find(getOrIntern(name));
+  if (!slot || isUndefined(globals->getValues()[*slot])) {
+    return std::nullopt;
   }
-  return varName;
+  return globals->getValues()[*slot];
 }
 
-InterpretResult VM::run() {
-  while (true) {
-#ifdef DEBUG_TRACE_EXECUTION
-    std::cout << "           ";
-    for (const auto& slot : stack) {
-      std::cout << "[ ";
-      printValue(slot);
-      std::cout << " ]";
+void VM::traceInstruction() {
+  std::ostream& out = tracer->out();
+  if (tracer->has(Tracer::STACK)) {
+    out << "           ";
+    for (Type* slot = stack.data(); slot < stackTop; slot++) {
+      out << "[ ";
+      printValue(*slot, out);
+      out << " ]";
     }
-    std::cout << "\n";
-    disassembleInstruction(*bytecode, currentInstructionAddress());
+    out << "\n";
+  }
+  if (tracer->has(Tracer::OPS)) {
+    disassembleInstruction(*bytecode, currentInstructionAddress(), out);
+  }
+}
+
+#define TRACE_INSTRUCTION()                                    \
+  do {                                                         \
+    if constexpr (mode & TRACE) {                              \
+      traceInstruction();                                      \
+    }                                                          \
+  } while (0)
+
+// Handlers are written once and compiled either as labels of a direct
+// threaded loop (every handler ends in its own indirect jump) or as cases of
+// a portable switch.
+#if defined(ONOL_THREADED_DISPATCH) && (defined(__GNUC__) || defined(__clang__))
+#define ONOL_COMPUTED_GOTO
 #endif
-    uint8_t instruction = readByte();
-    switch (static_cast<OpCode>(instruction)) {
-      case OpCode::CONSTANT: {
-        Type constant = readConstant();
-        push(constant);
-        break;
-      }
-      case OpCode::CONSTANT_LONG: {
-        Type constant = readConstantLong();
-        push(constant);
-        break;
-      }
-      case OpCode::DEFINE_GLOBAL: {
-        ObjString* objName = asString(readConstant());
-        globals[objName->value] = peek(0);
-        pop();
-        break;
-      }
-      case OpCode::DEFINE_GLOBAL_LONG: {
-        ObjString* objName = asString(readConstantLong());
-        globals[objName->value] = peek(0);
-        pop();
-        break;
-      }
-      case OpCode::GET_GLOBAL: {
-        String varName = checkVarExistsAndGetName(readConstant());
-        push(globals[varName]);
-        break;
-      }
-      case OpCode::GET_GLOBAL_LONG: {
-        String varName = checkVarExistsAndGetName(readConstantLong());
-        push(globals[varName]);
-        break;
-      }
-      case OpCode::SET_GLOBAL: {
-        String varName = checkVarExistsAndGetName(readConstant());
-        globals[varName] = peek(0);
-        break;
-      }
-      case OpCode::SET_GLOBAL_LONG: {
-        String varName = checkVarExistsAndGetName(readConstantLong());
-        globals[varName] = peek(0);
-        break;
-      }
-      case OpCode::ADD: {
-        binaryOp(std::plus<>());
-        break;
-      }
-      case OpCode::SUBTRACT: {
-        binaryOp(std::minus<>());
-        break;
-      }
-      case OpCode::MULTIPLY: {
-        binaryOp(std::multiplies<>());
-        break;
-      }
-      case OpCode::DIVIDE: {
-        binaryOp(std::divides<>());
-        break;
-      }
-      case OpCode::NEGATE: {
-        Type value = pop();
-        std::visit(
-            [this](auto&& arg) {
-              using T = std::decay_t<decltype(arg)>;
-              if constexpr (std::is_same_v<T, int32_t> ||
-                            std::is_same_v<T, double>) {
-                push(-arg);
-              } else {
-                throw RuntimeError(getCurrentLine(),
-                                   "Operand must be a number.");
-              }
-            },
-            value);
-        break;
-      }
-      case OpCode::NOT: {
-        Type val = pop();
-        if (isBool(val)) {
-          bool boolVal = asBool(val);
-          push(!boolVal);
-        } else {
-          throw RuntimeError(getCurrentLine(),
-                             "Operand must be a boolean value.");
-        }
-        break;
-      }
-      case OpCode::POP: {
-        pop();
-        break;
-      }
-      case OpCode::RETURN: {
-        return InterpretResult::INTERPRET_OK;
-      }
-      case OpCode::FALSE: {
-        push(false);
-        break;
-      }
-      case OpCode::TRUE: {
-        push(true);
-        break;
-      }
-      case OpCode::EQUAL: {
-        Type b = pop();
-        Type a = pop();
-        push(valuesEqual(a, b));
-        break;
-      }
-      case OpCode::GREATER: {
-        binaryOp(std::greater<>());
-        break;
-      }
-      case OpCode::GREATER_EQUAL: {
-        binaryOp(std::greater_equal<>());
-        break;
-      }
-      case OpCode::LESS: {
-        binaryOp(std::less<>());
-        break;
-      }
-      case OpCode::LESS_EQUAL: {
-        binaryOp(std::less_equal<>());
-        break;
-      }
-      case OpCode::NOT_EQUAL: {
-        Type b = pop();
-        Type a = pop();
-        push(!valuesEqual(a, b));
-        break;
-      }
-      case OpCode::NUL: {
-        push(Null{});
-        break;
-      }
+
+#define PROFILE_INSTRUCTION()                                  \
+  do {                                                         \
+    if constexpr (mode & PROFILE) {                            \
+      profiler->countInstruction(*ip, ip - codeStart);         \
+    }                                                          \
+  } while (0)
+
+#ifdef ONOL_COMPUTED_GOTO
+#define CASE(name) op_##name:
+#define DISPATCH()                   \
+  do {                               \
+    TRACE_INSTRUCTION();             \
+    PROFILE_INSTRUCTION();           \
+    goto* dispatchTable[readByte()]; \
+  } while (0)
+#else
+#define CASE(name) case OpCode::name:
+#define DISPATCH() break
+#endif
+
+#ifdef ONOL_COMPUTED_GOTO
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+template <unsigned mode>
+InterpretResult VM::execute() {
+  [[maybe_unused]] const uint8_t* codeStart = bytecode->getCodePointer();
+
+#ifdef ONOL_COMPUTED_GOTO
+  static void* const dispatchTable[] = {
+      &&op_CONSTANT,      &&op_CONSTANT_LONG,   &&op_DEFINE_GLOBAL,
+      &&op_DEFINE_GLOBAL_LONG, &&op_GET_GLOBAL, &&op_GET_GLOBAL_LONG,
+      &&op_SET_GLOBAL,    &&op_SET_GLOBAL_LONG, &&op_NUL,
+      &&op_TRUE,          &&op_FALSE,           &&op_ADD,
+      &&op_SUBTRACT,      &&op_MULTIPLY,        &&op_DIVIDE,
+      &&op_NEGATE,        &&op_NOT,             &&op_EQUAL,
+      &&op_GREATER,       &&op_LESS,            &&op_GREATER_EQUAL,
+      &&op_LESS_EQUAL,    &&op_NOT_EQUAL,       &&op_POP,
+      &&op_RETURN,        &&op_ADD_INT,         &&op_SUBTRACT_INT,
+      &&op_MULTIPLY_INT,  &&op_DIVIDE_INT,      &&op_ADD_DOUBLE,
+      &&op_SUBTRACT_DOUBLE, &&op_MULTIPLY_DOUBLE, &&op_DIVIDE_DOUBLE,
+      &&op_GREATER_INT,   &&op_LESS_INT,        &&op_GREATER_EQUAL_INT,
+      &&op_LESS_EQUAL_INT, &&op_GREATER_DOUBLE, &&op_LESS_DOUBLE,
+      &&op_GREATER_EQUAL_DOUBLE, &&op_LESS_EQUAL_DOUBLE, &&op_NEGATE_INT,
+      &&op_NEGATE_DOUBLE, &&op_CONCAT_STR,      &&op_COERCE,
+      &&op_ADD_CONSTANT,  &&op_SUBTRACT_CONSTANT,
+      &&op_MULTIPLY_CONSTANT, &&op_DIVIDE_CONSTANT, &&op_ADD_GLOBALS,
+      &&op_SUBTRACT_GLOBALS, &&op_MULTIPLY_GLOBALS, &&op_DIVIDE_GLOBALS,
+      &&op_SET_GLOBAL_POP,
+      &&op_ADD_INT_QUICK, &&op_SUBTRACT_INT_QUICK, &&op_MULTIPLY_INT_QUICK,
+      &&op_DIVIDE_INT_QUICK, &&op_ADD_DOUBLE_QUICK, &&op_SUBTRACT_DOUBLE_QUICK,
+      &&op_MULTIPLY_DOUBLE_QUICK, &&op_DIVIDE_DOUBLE_QUICK, &&op_GREATER_INT_QUICK,
+      &&op_LESS_INT_QUICK, &&op_GREATER_EQUAL_INT_QUICK, &&op_LESS_EQUAL_INT_QUICK,
+      &&op_GREATER_DOUBLE_QUICK, &&op_LESS_DOUBLE_QUICK, &&op_GREATER_EQUAL_DOUBLE_QUICK,
+      &&op_LESS_EQUAL_DOUBLE_QUICK, &&op_CONCAT_STR_QUICK,
+      &&op_GET_GLOBAL_QUICK, &&op_GET_GLOBAL_LONG_QUICK,
+  };
+  static_assert(std::size(dispatchTable) ==
+                    static_cast<std::size_t>(OpCode::OPCODE_COUNT),
+                "dispatchTable must list every OpCode in declaration order");
+
+  DISPATCH();
+#else
+  while (true) {
+    TRACE_INSTRUCTION();
+    PROFILE_INSTRUCTION();
+    switch (static_cast<OpCode>(readByte())) {
+#endif
+  CASE(CONSTANT) {
+    Type constant = readConstant();
+    push(constant);
+    DISPATCH();
+  }
+  CASE(CONSTANT_LONG) {
+    Type constant = readConstantLong();
+    push(constant);
+    DISPATCH();
+  }
+  CASE(DEFINE_GLOBAL) {
+    storeGlobal(readGlobal(), pop());
+    DISPATCH();
+  }
+  CASE(DEFINE_GLOBAL_LONG) {
+    storeGlobal(readGlobalLong(), pop());
+    DISPATCH();
+  }
+  CASE(GET_GLOBAL) {
+    const Type& global = readGlobal();
+    if (isUndefined(global)) undefinedVariable(&global - globalValues);
+    quicken(ip - 2, OpCode::GET_GLOBAL_QUICK);
+    push(global);
+    DISPATCH();
+  }
+  CASE(GET_GLOBAL_LONG) {
+    const Type& global = readGlobalLong();
+    if (isUndefined(global)) undefinedVariable(&global - globalValues);
+    quicken(ip - 4, OpCode::GET_GLOBAL_LONG_QUICK);
+    push(global);
+    DISPATCH();
+  }
+  CASE(SET_GLOBAL) {
+    Type& global = readGlobal();
+    if (isUndefined(global)) undefinedVariable(&global - globalValues);
+    storeGlobal(global, peek(0));
+    DISPATCH();
+  }
+  CASE(SET_GLOBAL_LONG) {
+    Type& global = readGlobalLong();
+    if (isUndefined(global)) undefinedVariable(&global - globalValues);
+    storeGlobal(global, peek(0));
+    DISPATCH();
+  }
+  CASE(ADD) {
+    quickenBinary(OpCode::ADD);
+    binaryOp(std::plus<>());
+    DISPATCH();
+  }
+  CASE(SUBTRACT) {
+    quickenBinary(OpCode::SUBTRACT);
+    binaryOp(std::minus<>());
+    DISPATCH();
+  }
+  CASE(MULTIPLY) {
+    quickenBinary(OpCode::MULTIPLY);
+    binaryOp(std::multiplies<>());
+    DISPATCH();
+  }
+  CASE(DIVIDE) {
+    quickenBinary(OpCode::DIVIDE);
+    binaryOp(std::divides<>());
+    DISPATCH();
+  }
+  CASE(NEGATE) {
+    OperationResult result = negate(pop());
+    if (result.error) throw RuntimeError(getCurrentLine(), result.error);
+    push(result.value);
+    DISPATCH();
+  }
+  CASE(NOT) {
+    OperationResult result = logicalNot(pop());
+    if (result.error) throw RuntimeError(getCurrentLine(), result.error);
+    push(result.value);
+    DISPATCH();
+  }
+  CASE(POP) {
+    pop();
+    DISPATCH();
+  }
+  CASE(RETURN) {
+    return InterpretResult::INTERPRET_OK;
+  }
+  CASE(FALSE) {
+    push(false);
+    DISPATCH();
+  }
+  CASE(TRUE) {
+    push(true);
+    DISPATCH();
+  }
+  CASE(EQUAL) {
+    Type b = pop();
+    Type a = pop();
+    push(valuesEqual(a, b));
+    DISPATCH();
+  }
+  CASE(GREATER) {
+    quickenBinary(OpCode::GREATER);
+    binaryOp(std::greater<>());
+    DISPATCH();
+  }
+  CASE(GREATER_EQUAL) {
+    quickenBinary(OpCode::GREATER_EQUAL);
+    binaryOp(std::greater_equal<>());
+    DISPATCH();
+  }
+  CASE(LESS) {
+    quickenBinary(OpCode::LESS);
+    binaryOp(std::less<>());
+    DISPATCH();
+  }
+  CASE(LESS_EQUAL) {
+    quickenBinary(OpCode::LESS_EQUAL);
+    binaryOp(std::less_equal<>());
+    DISPATCH();
+  }
+  CASE(NOT_EQUAL) {
+    Type b = pop();
+    Type a = pop();
+    push(!valuesEqual(a, b));
+    DISPATCH();
+  }
+  CASE(NUL) {
+    push(Null{});
+    DISPATCH();
+  }
+  CASE(ADD_INT) {
+    intBinaryOp(std::plus<>());
+    DISPATCH();
+  }
+  CASE(SUBTRACT_INT) {
+    intBinaryOp(std::minus<>());
+    DISPATCH();
+  }
+  CASE(MULTIPLY_INT) {
+    intBinaryOp(std::multiplies<>());
+    DISPATCH();
+  }
+  CASE(DIVIDE_INT) {
+    intBinaryOp(std::divides<>());
+    DISPATCH();
+  }
+  CASE(ADD_DOUBLE) {
+    doubleBinaryOp(std::plus<>());
+    DISPATCH();
+  }
+  CASE(SUBTRACT_DOUBLE) {
+    doubleBinaryOp(std::minus<>());
+    DISPATCH();
+  }
+  CASE(MULTIPLY_DOUBLE) {
+    doubleBinaryOp(std::multiplies<>());
+    DISPATCH();
+  }
+  CASE(DIVIDE_DOUBLE) {
+    doubleBinaryOp(std::divides<>());
+    DISPATCH();
+  }
+  CASE(GREATER_INT) {
+    intBinaryOp(std::greater<>());
+    DISPATCH();
+  }
+  CASE(LESS_INT) {
+    intBinaryOp(std::less<>());
+    DISPATCH();
+  }
+  CASE(GREATER_EQUAL_INT) {
+    intBinaryOp(std::greater_equal<>());
+    DISPATCH();
+  }
+  CASE(LESS_EQUAL_INT) {
+    intBinaryOp(std::less_equal<>());
+    DISPATCH();
+  }
+  CASE(GREATER_DOUBLE) {
+    doubleBinaryOp(std::greater<>());
+    DISPATCH();
+  }
+  CASE(LESS_DOUBLE) {
+    doubleBinaryOp(std::less<>());
+    DISPATCH();
+  }
+  CASE(GREATER_EQUAL_DOUBLE) {
+    doubleBinaryOp(std::greater_equal<>());
+    DISPATCH();
+  }
+  CASE(LESS_EQUAL_DOUBLE) {
+    doubleBinaryOp(std::less_equal<>());
+    DISPATCH();
+  }
+  CASE(NEGATE_INT) {
+    push(negateInt(asInt(pop())));
+    DISPATCH();
+  }
+  CASE(NEGATE_DOUBLE) {
+    push(-asDouble(pop()));
+    DISPATCH();
+  }
+  CASE(CONCAT_STR) {
+    Type b = pop();
+    Type a = pop();
+    push(concatenateStrings(a, b, &heap));
+    DISPATCH();
+  }
+  CASE(COERCE) {
+    StaticType type = static_cast<StaticType>(readByte());
+    OperationResult result = coerce(pop(), type);
+    if (result.error) throw RuntimeError(getCurrentLine(), result.error);
+    push(result.value);
+    DISPATCH();
+  }
+  CASE(ADD_CONSTANT) {
+    Type b = readConstant();
+    pushBinary(std::plus<>(), pop(), b);
+    DISPATCH();
+  }
+  CASE(SUBTRACT_CONSTANT) {
+    Type b = readConstant();
+    pushBinary(std::minus<>(), pop(), b);
+    DISPATCH();
+  }
+  CASE(MULTIPLY_CONSTANT) {
+    Type b = readConstant();
+    pushBinary(std::multiplies<>(), pop(), b);
+    DISPATCH();
+  }
+  CASE(DIVIDE_CONSTANT) {
+    Type b = readConstant();
+    pushBinary(std::divides<>(), pop(), b);
+    DISPATCH();
+  }
+  CASE(ADD_GLOBALS) {
+    const Type& a = readDefinedGlobal();
+    pushBinary(std::plus<>(), a, readDefinedGlobal());
+    DISPATCH();
+  }
+  CASE(SUBTRACT_GLOBALS) {
+    const Type& a = readDefinedGlobal();
+    pushBinary(std::minus<>(), a, readDefinedGlobal());
+    DISPATCH();
+  }
+  CASE(MULTIPLY_GLOBALS) {
+    const Type& a = readDefinedGlobal();
+    pushBinary(std::multiplies<>(), a, readDefinedGlobal());
+    DISPATCH();
+  }
+  CASE(DIVIDE_GLOBALS) {
+    const Type& a = readDefinedGlobal();
+    pushBinary(std::divides<>(), a, readDefinedGlobal());
+    DISPATCH();
+  }
+  CASE(SET_GLOBAL_POP) {
+    Type& global = readGlobal();
+    if (isUndefined(global)) undefinedVariable(&global - globalValues);
+    storeGlobal(global, pop());
+    DISPATCH();
+  }
+  CASE(ADD_INT_QUICK) {
+    guardedIntOp(std::plus<>(), OpCode::ADD);
+    DISPATCH();
+  }
+  CASE(SUBTRACT_INT_QUICK) {
+    guardedIntOp(std::minus<>(), OpCode::SUBTRACT);
+    DISPATCH();
+  }
+  CASE(MULTIPLY_INT_QUICK) {
+    guardedIntOp(std::multiplies<>(), OpCode::MULTIPLY);
+    DISPATCH();
+  }
+  CASE(DIVIDE_INT_QUICK) {
+    guardedIntOp(std::divides<>(), OpCode::DIVIDE);
+    DISPATCH();
+  }
+  CASE(GREATER_INT_QUICK) {
+    guardedIntOp(std::greater<>(), OpCode::GREATER);
+    DISPATCH();
+  }
+  CASE(LESS_INT_QUICK) {
+    guardedIntOp(std::less<>(), OpCode::LESS);
+    DISPATCH();
+  }
+  CASE(GREATER_EQUAL_INT_QUICK) {
+    guardedIntOp(std::greater_equal<>(), OpCode::GREATER_EQUAL);
+    DISPATCH();
+  }
+  CASE(LESS_EQUAL_INT_QUICK) {
+    guardedIntOp(std::less_equal<>(), OpCode::LESS_EQUAL);
+    DISPATCH();
+  }
+  CASE(ADD_DOUBLE_QUICK) {
+    guardedDoubleOp(std::plus<>(), OpCode::ADD);
+    DISPATCH();
+  }
+  CASE(SUBTRACT_DOUBLE_QUICK) {
+    guardedDoubleOp(std::minus<>(), OpCode::SUBTRACT);
+    DISPATCH();
+  }
+  CASE(MULTIPLY_DOUBLE_QUICK) {
+    guardedDoubleOp(std::multiplies<>(), OpCode::MULTIPLY);
+    DISPATCH();
+  }
+  CASE(DIVIDE_DOUBLE_QUICK) {
+    guardedDoubleOp(std::divides<>(), OpCode::DIVIDE);
+    DISPATCH();
+  }
+  CASE(GREATER_DOUBLE_QUICK) {
+    guardedDoubleOp(std::greater<>(), OpCode::GREATER);
+    DISPATCH();
+  }
+  CASE(LESS_DOUBLE_QUICK) {
+    guardedDoubleOp(std::less<>(), OpCode::LESS);
+    DISPATCH();
+  }
+  CASE(GREATER_EQUAL_DOUBLE_QUICK) {
+    guardedDoubleOp(std::greater_equal<>(), OpCode::GREATER_EQUAL);
+    DISPATCH();
+  }
+  CASE(LESS_EQUAL_DOUBLE_QUICK) {
+    guardedDoubleOp(std::less_equal<>(), OpCode::LESS_EQUAL);
+    DISPATCH();
+  }
+  CASE(CONCAT_STR_QUICK) {
+    if (isString(peek(0)) && isString(peek(1))) {
+      Type b = pop();
+      Type a = pop();
+      push(concatenateStrings(a, b, &heap));
+    } else {
+      quicken(ip - 1, OpCode::ADD);
+      binaryOp(std::plus<>());
+    }
+    DISPATCH();
+  }
+  CASE(GET_GLOBAL_QUICK) {
+    push(readGlobal());
+    DISPATCH();
+  }
+  CASE(GET_GLOBAL_LONG_QUICK) {
+    push(readGlobalLong());
+    DISPATCH();
+  }
+#ifndef ONOL_COMPUTED_GOTO
       default: {
-        break;
+        throw RuntimeError(getCurrentLine(), "Unknown opcode.");
       }
     }
   }
-  return InterpretResult::INTERPRET_OK;
+#endif
+}
+
+#ifdef ONOL_COMPUTED_GOTO
+#pragma GCC diagnostic pop
+#endif
+
+InterpretResult VM::run() {
+  unsigned mode = tracer ? TRACE : PLAIN;
+#ifdef ONOL_PROFILER
+  if (profiler) mode |= PROFILE;
+#endif
+
+  switch (mode) {
+    case TRACE:
+      return execute<TRACE>();
+#ifdef ONOL_PROFILER
+    case PROFILE:
+      return execute<PROFILE>();
+    case PROFILE | TRACE:
+      return execute<PROFILE | TRACE>();
+#endif
+    default:
+      return execute<PLAIN>();
+  }
 }
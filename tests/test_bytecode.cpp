@@ -1,8 +1,17 @@
 #include <catch2/catch_all.hpp>
 #include <catch2/catch_test_macros.hpp>
 
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
 #include "allocator.hpp"
 #include "bytecode.hpp"
+#include "bytecode_file.hpp"
+#include "globals.hpp"
+#include "interned_strings.hpp"
+#include "line_table.hpp"
+#include "vm.hpp"
 
 TEST_CASE("Bytecode basic operations", "[bytecode]") {
   SECTION("An instruction is added to the bytecode with the correct line") {
@@ -67,7 +76,7 @@ TEST_CASE("Bytecode constant operations", "[bytecode]") {
   SECTION("Adding multiple constants to the bytecode and verifying their addresses") {
     Bytecode bytecode;
     Type valueInt = 10;
-    Type valueStr = allocateAndConstruct<ObjString>("test");
+    Type valueStr = ObjString::create("test");
     uint32_t line1 = 10;
     uint32_t line2 = 20;
 
@@ -86,7 +95,7 @@ TEST_CASE("Bytecode instruction tests", "[bytecode]") {
   SECTION("Adding CONSTANT and CONSTANT_LONG instructions") {
     Bytecode bytecode;
     Type valueInt = 10;
-    Type valueStr = allocateAndConstruct<ObjString>("test");
+    Type valueStr = ObjString::create("test");
     uint32_t line1 = 10;
     uint32_t line2 = 20;
 
@@ -98,10 +107,404 @@ TEST_CASE("Bytecode instruction tests", "[bytecode]") {
     REQUIRE(bytecode.getLine(0) == line1);
 
     for (int i = 0; i < 300; i++) {
-      bytecode.putConstant(110, line2);
+      bytecode.putConstant(1000 + i, line2);
     }
-    std::size_t addressLong = bytecode.putConstant(valueStr, line2);
+    Type valueLong = ObjString::create("long");
+    std::size_t addressLong = bytecode.putConstant(valueLong, line2);
     REQUIRE(bytecode.getOpCode(696) == OpCode::CONSTANT_LONG);
+    REQUIRE(addressLong == 302);
     CHECK(bytecode.getLine(696) == line2);
   }
 }
+
+TEST_CASE("Bytecode constant deduplication", "[bytecode]") {
+  SECTION("Identical constants share one pool entry") {
+    Bytecode bytecode;
+    Type name = ObjString::create("counter");
+
+    std::size_t first = bytecode.createConstant(name);
+    for (int i = 0; i < 1000; i++) {
+      REQUIRE(bytecode.createConstant(name) == first);
+    }
+    REQUIRE(bytecode.createConstant(7) == bytecode.createConstant(7));
+    REQUIRE(bytecode.createConstant(2.5) == bytecode.createConstant(2.5));
+  }
+
+  SECTION("Repeated constants keep the short encoding") {
+    Bytecode bytecode;
+
+    for (int i = 0; i < 1000; i++) {
+      bytecode.putConstant(i % 10, 1);
+    }
+
+    for (std::size_t offset = 0; offset < bytecode.count(); offset += 2) {
+      REQUIRE(bytecode.getOpCode(offset) == OpCode::CONSTANT);
+    }
+  }
+
+  SECTION("Constants of different types or bits stay distinct") {
+    Bytecode bytecode;
+
+    std::size_t integer = bytecode.createConstant(1);
+    std::size_t floating = bytecode.createConstant(1.0);
+    std::size_t positiveZero = bytecode.createConstant(0.0);
+    std::size_t negativeZero = bytecode.createConstant(-0.0);
+    std::size_t boolean = bytecode.createConstant(true);
+
+    REQUIRE(integer != floating);
+    REQUIRE(positiveZero != negativeZero);
+    REQUIRE(boolean != integer);
+  }
+
+  SECTION("Equal but distinct string objects are not merged") {
+    Bytecode bytecode;
+    Type first = ObjString::create("text");
+    Type second = ObjString::create("text");
+
+    REQUIRE(bytecode.createConstant(first) !=
+            bytecode.createConstant(second));
+  }
+}
+
+TEST_CASE("Bytecode stack depth", "[bytecode]") {
+  SECTION("An empty chunk needs no stack") {
+    Bytecode bytecode;
+    bytecode.putOpCode(OpCode::RETURN, 1);
+
+    REQUIRE(bytecode.computeStackDepth().max == 0);
+  }
+
+  SECTION("The deepest point of the chunk is reported") {
+    Bytecode bytecode;
+    bytecode.putConstant(1, 1);
+    bytecode.putConstant(2, 1);
+    bytecode.putConstant(3, 2);
+    bytecode.putOpCode(OpCode::ADD, 2);
+    bytecode.putOpCode(OpCode::ADD, 2);
+    bytecode.putOpCode(OpCode::POP, 2);
+    bytecode.putOpCode(OpCode::TRUE, 3);
+    bytecode.putOpCode(OpCode::RETURN, 3);
+
+    StackDepth depth = bytecode.computeStackDepth();
+
+    REQUIRE(depth.max == 3);
+    REQUIRE(depth.offset == 4);
+    REQUIRE(bytecode.getLine(depth.offset) == 2);
+  }
+}
+
+TEST_CASE("Bytecode stack depth is kept until the code changes",
+          "[bytecode]") {
+  Bytecode bytecode;
+  bytecode.putOpCode(OpCode::TRUE, 1);
+  bytecode.putOpCode(OpCode::RETURN, 1);
+  REQUIRE(bytecode.stackDepth().max == 1);
+
+  // Only the first call walks the code, so in-place rewrites like
+  // quickening are not seen.
+  bytecode.getCodePointer()[0] = 200;
+  REQUIRE(bytecode.stackDepth().max == 1);
+  REQUIRE_THROWS_AS(bytecode.computeStackDepth(), BytecodeError);
+
+  bytecode.truncate(0);
+  bytecode.putOpCode(OpCode::RETURN, 1);
+  REQUIRE(bytecode.stackDepth().max == 0);
+}
+
+TEST_CASE("Bytecode validation", "[bytecode]") {
+  SECTION("Unknown opcodes are rejected") {
+    Bytecode bytecode;
+    bytecode.putRaw(static_cast<uint8_t>(200), 1);
+    bytecode.putOpCode(OpCode::RETURN, 1);
+
+    REQUIRE_THROWS_AS(bytecode.computeStackDepth(), BytecodeError);
+  }
+
+  SECTION("Truncated operands are rejected") {
+    Bytecode bytecode;
+    bytecode.putOpCode(OpCode::RETURN, 1);
+    bytecode.putOpCode(OpCode::CONSTANT_LONG, 1);
+    bytecode.putRaw(static_cast<uint8_t>(0), 1);
+
+    REQUIRE_THROWS_AS(bytecode.computeStackDepth(), BytecodeError);
+  }
+
+  SECTION("Chunks must end in RETURN") {
+    Bytecode bytecode;
+    bytecode.putOpCode(OpCode::TRUE, 1);
+
+    REQUIRE_THROWS_AS(bytecode.computeStackDepth(), BytecodeError);
+  }
+
+  SECTION("Instructions may not pop an empty stack") {
+    Bytecode bytecode;
+    bytecode.putOpCode(OpCode::TRUE, 1);
+    bytecode.putOpCode(OpCode::ADD, 1);
+    bytecode.putOpCode(OpCode::RETURN, 1);
+
+    REQUIRE_THROWS_AS(bytecode.computeStackDepth(), BytecodeError);
+  }
+
+  SECTION("Constant indices must be in the pool") {
+    Bytecode bytecode;
+    bytecode.putConstant(1, 1);
+    bytecode.putOpCode(OpCode::ADD_CONSTANT, 1);
+    bytecode.putRaw(static_cast<uint8_t>(0), 1);
+    bytecode.putOpCode(OpCode::RETURN, 1);
+    REQUIRE_NOTHROW(bytecode.computeStackDepth());
+
+    bytecode.getCodePointer()[3] = 1;
+    REQUIRE_THROWS_AS(bytecode.computeStackDepth(), BytecodeError);
+
+    Bytecode longForm;
+    longForm.putOpCode(OpCode::CONSTANT_LONG, 1);
+    longForm.putRaw(static_cast<std::size_t>(1 << 16), 1);
+    longForm.putOpCode(OpCode::RETURN, 1);
+    REQUIRE_THROWS_AS(longForm.computeStackDepth(), BytecodeError);
+  }
+
+  SECTION("Stores into typed globals must be of the declared type") {
+    auto globals = std::make_shared<GlobalTable>();
+    std::size_t slot = globals->resolve(getOrIntern("typed"));
+    globals->declare(slot, StaticType::INT);
+
+    Bytecode proven;
+    proven.setGlobals(globals);
+    proven.putConstant(1, 1);
+    proven.putOpCode(OpCode::DEFINE_GLOBAL, 1);
+    proven.putRaw(static_cast<uint8_t>(slot), 1);
+    proven.putOpCode(OpCode::RETURN, 1);
+    REQUIRE_NOTHROW(proven.computeStackDepth());
+
+    Bytecode unproven;
+    unproven.setGlobals(globals);
+    unproven.putOpCode(OpCode::TRUE, 1);
+    unproven.putOpCode(OpCode::DEFINE_GLOBAL, 1);
+    unproven.putRaw(static_cast<uint8_t>(slot), 1);
+    unproven.putOpCode(OpCode::RETURN, 1);
+    REQUIRE_THROWS_AS(unproven.computeStackDepth(), BytecodeError);
+  }
+
+  SECTION("Coercions name a known type") {
+    Bytecode bytecode;
+    bytecode.putOpCode(OpCode::TRUE, 1);
+    bytecode.putOpCode(OpCode::COERCE, 1);
+    bytecode.putRaw(static_cast<uint8_t>(0xff), 1);
+    bytecode.putOpCode(OpCode::RETURN, 1);
+
+    REQUIRE_THROWS_AS(bytecode.computeStackDepth(), BytecodeError);
+  }
+}
+
+TEST_CASE("Bytecode files", "[bytecode]") {
+  std::string path =
+      (std::filesystem::temp_directory_path() / "onol_test.onolc").string();
+  std::string source =
+      "int a = 40\nstring s = \"pre\" \nlet t = s + \"compiled\"\n"
+      "double d = a + 2\n";
+
+  VM compiler;
+  std::shared_ptr<Bytecode> chunk = compiler.compile(source);
+  REQUIRE(chunk);
+  writeBytecodeFile(*chunk, path);
+  REQUIRE(isBytecodeFile(path));
+
+  SECTION("A loaded chunk runs like the compiled one") {
+    VM vm;
+    std::shared_ptr<Bytecode> loaded = vm.load(path);
+    REQUIRE(loaded);
+    REQUIRE(loaded->count() == chunk->count());
+    for (std::size_t offset = 0; offset < chunk->count(); offset++) {
+      REQUIRE(loaded->getOpCode(offset) == chunk->getOpCode(offset));
+      REQUIRE(loaded->getLine(offset) == chunk->getLine(offset));
+    }
+
+    REQUIRE(vm.interpret(loaded) == InterpretResult::INTERPRET_OK);
+    REQUIRE(asString(*vm.getGlobal("t"))->view() == "precompiled");
+    REQUIRE(asDouble(*vm.getGlobal("d")) == 42.0);
+  }
+
+  SECTION("String constants are interned when a loaded chunk first runs") {
+    VM vm;
+    std::shared_ptr<Bytecode> loaded = vm.load(path);
+    REQUIRE(loaded);
+    auto pending = [&loaded] {
+      const auto& pool = loaded->getConstantPool();
+      return std::count_if(pool.begin(), pool.end(), [](const Type& value) {
+        return isUndefined(value);
+      });
+    };
+    REQUIRE(pending() > 0);
+
+    REQUIRE(vm.interpret(loaded) == InterpretResult::INTERPRET_OK);
+    REQUIRE(pending() == 0);
+  }
+
+  SECTION("Global slots are remapped into a table that is in use") {
+    VM vm;
+    REQUIRE(vm.interpret("int other = 1\nlet t = 0") ==
+            InterpretResult::INTERPRET_OK);
+
+    std::shared_ptr<Bytecode> loaded = vm.load(path);
+    REQUIRE(loaded);
+    REQUIRE(vm.interpret(loaded) == InterpretResult::INTERPRET_OK);
+    REQUIRE(asInt(*vm.getGlobal("other")) == 1);
+    REQUIRE(asInt(*vm.getGlobal("a")) == 40);
+    REQUIRE(asString(*vm.getGlobal("t"))->view() == "precompiled");
+  }
+
+  SECTION("Declared types of the file are enforced") {
+    VM vm;
+    REQUIRE(vm.interpret("string a = \"a\"") ==
+            InterpretResult::INTERPRET_OK);
+
+    REQUIRE_FALSE(vm.load(path));
+  }
+
+  SECTION("Files from another version are rejected") {
+    {
+      std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+      file.seekp(4);
+      file.put(static_cast<char>(BYTECODE_FILE_VERSION + 1));
+    }
+
+    VM vm;
+    REQUIRE_FALSE(vm.load(path));
+  }
+
+  SECTION("Truncated files are rejected") {
+    std::filesystem::resize_file(path, 30);
+
+    VM vm;
+    REQUIRE_FALSE(vm.load(path));
+  }
+
+  SECTION("A chunk that has run is written with generic opcodes") {
+    REQUIRE(compiler.interpret(chunk) == InterpretResult::INTERPRET_OK);
+    writeBytecodeFile(*chunk, path);
+
+    VM vm;
+    std::shared_ptr<Bytecode> loaded = vm.load(path);
+    REQUIRE(loaded);
+    for (std::size_t offset = 0; offset < loaded->count();
+         offset += instructionLength(loaded->getOpCode(offset))) {
+      OpCode opCode = loaded->getOpCode(offset);
+      REQUIRE(genericOpCode(opCode) == opCode);
+    }
+    REQUIRE(vm.interpret(loaded) == InterpretResult::INTERPRET_OK);
+    REQUIRE(asDouble(*vm.getGlobal("d")) == 42.0);
+  }
+
+  SECTION("Files with invalid instructions are rejected") {
+    Bytecode corrupt;
+    corrupt.putOpCode(OpCode::TRUE, 1);
+    corrupt.putOpCode(OpCode::TRUE, 1);
+    corrupt.putOpCode(OpCode::ADD, 1);
+    corrupt.putOpCode(OpCode::POP, 1);
+    corrupt.putOpCode(OpCode::RETURN, 1);
+    writeBytecodeFile(corrupt, path);
+    // The code follows the 24 byte header.
+    auto patch = [&path](std::size_t offset, OpCode opCode) {
+      std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+      file.seekp(24 + offset);
+      file.put(static_cast<char>(opCode));
+    };
+    REQUIRE(VM().load(path));
+
+    SECTION("Quickened opcodes") {
+      patch(2, OpCode::ADD_INT_QUICK);
+      REQUIRE_FALSE(VM().load(path));
+    }
+
+    SECTION("Stack underflow") {
+      patch(1, OpCode::POP);
+      REQUIRE_FALSE(VM().load(path));
+    }
+
+    SECTION("Constant indices past the pool") {
+      patch(1, OpCode::CONSTANT);
+      REQUIRE_FALSE(VM().load(path));
+    }
+
+    SECTION("Unknown coercion types") {
+      patch(1, OpCode::COERCE);
+      patch(2, static_cast<OpCode>(0xff));
+      REQUIRE_FALSE(VM().load(path));
+    }
+
+    SECTION("Typed opcodes on operands of other types") {
+      patch(2, OpCode::CONCAT_STR);
+      REQUIRE_FALSE(VM().load(path));
+      patch(2, OpCode::ADD_INT);
+      REQUIRE_FALSE(VM().load(path));
+    }
+  }
+
+  SECTION("Typed opcodes on globals of unknown type are rejected") {
+    compiler.setOptimize(false);
+    std::shared_ptr<Bytecode> untyped =
+        compiler.compile("let x = 1\nlet y = 2\nx + y");
+    REQUIRE(untyped);
+    writeBytecodeFile(*untyped, path);
+
+    std::size_t add = 0;
+    while (untyped->getOpCode(add) != OpCode::ADD) {
+      add += instructionLength(untyped->getOpCode(add));
+    }
+    {
+      std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+      file.seekp(24 + add);
+      file.put(static_cast<char>(OpCode::CONCAT_STR));
+    }
+
+    REQUIRE_FALSE(VM().load(path));
+  }
+
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("Line table", "[bytecode]") {
+  LineTable table;
+  for (uint32_t line = 1; line <= 100000; line++) {
+    for (std::size_t i = 0; i < line % 3 + 1; i++) {
+      table.add(table.size() == 0 ? 0 : 4 * line + i, line);
+    }
+  }
+
+  SECTION("Runs of bytes on the same line share one entry") {
+    REQUIRE(table.size() == 100000);
+  }
+
+  SECTION("Lookups find the run containing an offset") {
+    REQUIRE(table.getLine(0) == 1);
+    REQUIRE(table.getLine(8) == 2);
+    REQUIRE(table.getLine(11) == 2);
+    REQUIRE(table.getLine(4 * 50000 + 2) == 50000);
+    REQUIRE(table.getLine(10000000) == 100000);
+  }
+
+  SECTION("Truncation drops the runs past the new end") {
+    table.truncate(12);
+    REQUIRE(table.size() == 2);
+    REQUIRE(table.getLine(100) == 2);
+  }
+
+  SECTION("The encoded form round trips") {
+    std::vector<uint8_t> encoded;
+    table.encode(encoded);
+    REQUIRE(encoded.size() < table.size() * 3);
+
+    std::optional<LineTable> decoded =
+        LineTable::decode(encoded.data(), encoded.size());
+    REQUIRE(decoded);
+    REQUIRE(decoded->size() == table.size());
+    for (std::size_t offset = 0; offset < 400000; offset += 997) {
+      REQUIRE(decoded->getLine(offset) == table.getLine(offset));
+    }
+  }
+
+  SECTION("Malformed encodings are rejected") {
+    uint8_t unterminated[] = {0x80};
+    REQUIRE_FALSE(LineTable::decode(unterminated, sizeof(unterminated)));
+  }
+}
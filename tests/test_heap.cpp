@@ -0,0 +1,289 @@
+#include <catch2/catch_all.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "dynamic_types.hpp"
+#include "heap.hpp"
+#include "interned_strings.hpp"
+#include "vm.hpp"
+
+TEST_CASE("Heap collects strings that are not reachable", "[heap]") {
+  Heap heap;
+  std::vector<Type> roots;
+  heap.setRootMarker([&roots](Heap& heap) {
+    for (Type& root : roots) {
+      heap.markValue(root);
+    }
+  });
+
+  ObjString* kept = heap.allocateString("kept");
+  roots.push_back(kept);
+  heap.allocateString("dropped");
+  REQUIRE(heap.objectCount() == 2);
+  REQUIRE(heap.bytesAllocated() ==
+          ObjString::sizeFor(4) + ObjString::sizeFor(7));
+
+  heap.collect();
+  REQUIRE(heap.objectCount() == 1);
+  REQUIRE(heap.bytesAllocated() == ObjString::sizeFor(4));
+  // The survivor moved out of the nursery and its root was updated.
+  kept = asString(roots[0]);
+  REQUIRE(kept->view() == "kept");
+  REQUIRE_FALSE(heap.isYoung(kept));
+  REQUIRE_FALSE(kept->marked);
+
+  SECTION("Shared interned strings are never marked") {
+    ObjString* interned = getOrIntern("interned");
+    roots.push_back(interned);
+    heap.collect();
+    REQUIRE_FALSE(interned->managed);
+    REQUIRE_FALSE(interned->marked);
+    REQUIRE(heap.objectCount() == 1);
+  }
+
+  SECTION("Collection is triggered by allocation volume") {
+    roots.clear();
+    std::string chunk(Heap::LARGE_OBJECT, 'x');
+    for (std::size_t i = 0; i < 4 * Heap::MIN_THRESHOLD / chunk.size();
+         i++) {
+      std::string id = std::to_string(i);
+      chunk.replace(0, id.size(), id);
+      heap.allocateString(chunk);
+    }
+    REQUIRE(heap.collections() > 1);
+    REQUIRE(heap.bytesAllocated() <= Heap::MIN_THRESHOLD);
+  }
+
+  SECTION("Stress mode collects on every allocation") {
+    heap.setStressMode(true);
+    std::size_t before = heap.collections();
+    heap.allocateString("stressed 1");
+    heap.allocateString("stressed 2");
+    REQUIRE(heap.collections() == before + 2);
+    REQUIRE(heap.objectCount() == 2);
+  }
+}
+
+TEST_CASE("Heap strings are interned weakly", "[heap]") {
+  Heap heap;
+  std::vector<Type> roots;
+  heap.setRootMarker([&roots](Heap& heap) {
+    for (Type& root : roots) {
+      heap.markValue(root);
+    }
+  });
+
+  ObjString* first = heap.allocateString("weak");
+  REQUIRE(heap.allocateString("weak") == first);
+  REQUIRE(heap.objectCount() == 1);
+  REQUIRE(heap.stringCount() == 1);
+
+  SECTION("Shared interned strings are reused") {
+    ObjString* interned = getOrIntern("shared");
+    REQUIRE(heap.allocateString("shared") == interned);
+    REQUIRE(heap.objectCount() == 1);
+  }
+
+  SECTION("Reachable strings stay interned") {
+    roots.push_back(first);
+    heap.allocateString("other");
+    heap.collect();
+    REQUIRE(heap.stringCount() == 1);
+    REQUIRE(heap.allocateString("weak") == asString(roots[0]));
+  }
+
+  SECTION("Several references to a young string share one copy") {
+    roots.push_back(first);
+    roots.push_back(first);
+    heap.collectNursery();
+    REQUIRE(asString(roots[0]) == asString(roots[1]));
+    REQUIRE(heap.objectCount() == 1);
+  }
+
+  SECTION("Unreachable strings leave the table") {
+    heap.collect();
+    REQUIRE(heap.stringCount() == 0);
+    REQUIRE(heap.objectCount() == 0);
+    REQUIRE(heap.allocateString("weak")->view() == "weak");
+    REQUIRE(heap.stringCount() == 1);
+  }
+}
+
+TEST_CASE("Short-lived strings die in the nursery", "[heap]") {
+  Heap heap;
+  // Checks when collections happen, which stress builds override.
+  heap.setStressMode(false);
+  std::vector<Type> roots;
+  heap.setRootMarker([&roots](Heap& heap) {
+    for (Type& root : roots) {
+      heap.markValue(root);
+    }
+  });
+
+  roots.push_back(heap.allocateString("survivor"));
+  REQUIRE(heap.isYoung(roots[0]));
+
+  std::size_t allocations = 2 * Heap::NURSERY_SIZE / 64;
+  for (std::size_t i = 0; i < allocations; i++) {
+    heap.allocateString("temporary " + std::to_string(i));
+  }
+  REQUIRE(heap.nurseryCollections() >= 1);
+  REQUIRE(heap.collections() == 0);
+  REQUIRE_FALSE(heap.isYoung(roots[0]));
+  REQUIRE(asString(roots[0])->view() == "survivor");
+  REQUIRE(heap.bytesAllocated() < Heap::NURSERY_SIZE + 1024);
+}
+
+TEST_CASE("Incremental collection runs in bounded slices", "[heap]") {
+  Heap heap;
+  heap.setStressMode(false);
+  std::vector<Type> roots;
+  heap.setRootMarker([&roots](Heap& heap) {
+    for (Type& root : roots) {
+      heap.markValue(root);
+    }
+  });
+
+  for (int i = 0; i < 100; i++) {
+    roots.push_back(heap.allocateString("old " + std::to_string(i)));
+  }
+  heap.collectNursery();
+  roots.resize(50);
+  REQUIRE(heap.objectCount() == 100);
+
+  heap.setIncremental(true, {10, std::chrono::microseconds(0)});
+  std::size_t slices = 0;
+  do {
+    heap.collectSlice();
+    slices++;
+  } while (heap.cycleInProgress());
+
+  // One slice scans the roots and at least ten sweep 100 objects.
+  REQUIRE(slices >= 11);
+  REQUIRE(heap.collections() == 1);
+  REQUIRE(heap.objectCount() == 50);
+  REQUIRE(heap.stringCount() == 50);
+  REQUIRE(heap.pauses().count == slices + 1);
+  REQUIRE(heap.pauses().max <= heap.pauses().total);
+  for (const Type& root : roots) {
+    ObjString* string = asString(root);
+    REQUIRE(heap.allocateString(string->view()) == string);
+  }
+}
+
+TEST_CASE("The write barrier keeps strings stored while marking", "[heap]") {
+  Heap heap;
+  heap.setStressMode(false);
+  std::vector<Type> stack;
+  std::vector<Type> globals;
+  heap.setRootMarker([&](Heap& heap) {
+    for (Type& value : stack) {
+      heap.markValue(value);
+    }
+    if (heap.rootScan() != Heap::RootScan::STACK) {
+      for (Type& value : globals) {
+        heap.markValue(value);
+      }
+    }
+  });
+
+  // An old string that nothing refers to when the cycle starts.
+  stack.push_back(heap.allocateString("revived"));
+  heap.collectNursery();
+  stack.clear();
+
+  heap.setIncremental(true, {1, std::chrono::microseconds(0)});
+  heap.collectSlice();
+  REQUIRE(heap.cycleInProgress());
+
+  // The weak table hands the white string back, and it is stored into a
+  // global that was already scanned.
+  Type revived = heap.allocateString("revived");
+  globals.push_back(revived);
+  heap.writeBarrier(revived);
+
+  while (heap.cycleInProgress()) {
+    heap.collectSlice();
+  }
+  REQUIRE(heap.objectCount() == 1);
+  REQUIRE(asString(globals[0])->view() == "revived");
+  REQUIRE(heap.allocateString("revived") == asString(globals[0]));
+}
+
+TEST_CASE("Globals written with young strings survive minor collections",
+          "[heap][vm]") {
+  VM vm;
+  std::string source = "string kept = \"\"\nint n = 0\n";
+  // Enough garbage between the stores for several minor collections.
+  for (int i = 0; i < 200; i++) {
+    source += "kept = \"kept \" + n\n";
+    for (int j = 0; j < 20; j++) {
+      source += "\"" + std::string(100, 'g') + "\" + n\n";
+      source += "n = n + 1\n";
+    }
+  }
+  REQUIRE(vm.interpret(source) == InterpretResult::INTERPRET_OK);
+  REQUIRE(vm.getHeap().nurseryCollections() > 1);
+  REQUIRE(asString(*vm.getGlobal("kept"))->view() == "kept 3980");
+}
+
+TEST_CASE("Scripts run under incremental collection", "[heap][vm]") {
+  VM vm;
+  vm.setStressGC(true);
+  vm.setIncrementalGC(true, {4, std::chrono::microseconds(0)});
+
+  std::string source = "string kept = \"\"\nstring text = \"a\"\nint n = 0\n";
+  for (int i = 0; i < 100; i++) {
+    source += "kept = \"kept \" + n\n";
+    source += "text = text + \"b\"\n";
+    source += "\"garbage\" + n\n";
+    source += "n = n + 1\n";
+  }
+  REQUIRE(vm.interpret(source) == InterpretResult::INTERPRET_OK);
+  REQUIRE(vm.getHeap().collections() > 1);
+  REQUIRE(asString(*vm.getGlobal("kept"))->view() == "kept 99");
+  REQUIRE(asString(*vm.getGlobal("text"))->view() ==
+          "a" + std::string(100, 'b'));
+}
+
+TEST_CASE("VM strings are collected while a script runs", "[heap][vm]") {
+  VM vm;
+  vm.setStressGC(true);
+
+  std::string source = "string text = \"a\"\nint n = 0\n";
+  for (int i = 0; i < 200; i++) {
+    source += "\"garbage\" + n\n";
+    source += "text = text + \"b\"\n";
+  }
+  REQUIRE(vm.interpret(source) == InterpretResult::INTERPRET_OK);
+
+  // Only the current value of `text` survives.
+  vm.collectGarbage();
+  REQUIRE(vm.getHeap().objectCount() == 1);
+  std::optional<Type> text = vm.getGlobal("text");
+  REQUIRE(text);
+  REQUIRE(asString(*text)->view() == "a" + std::string(200, 'b'));
+}
+
+TEST_CASE("Runtime strings compare by contents", "[heap][vm]") {
+  VM vm;
+  REQUIRE(vm.interpret("string ab = \"a\" + \"b\"\n"
+                       "string a = \"a\"\n"
+                       "bool same = a + \"b\" == ab\n"
+                       "bool different = a + \"c\" != ab\n") ==
+          InterpretResult::INTERPRET_OK);
+  REQUIRE(asBool(*vm.getGlobal("same")));
+  REQUIRE(asBool(*vm.getGlobal("different")));
+}
+
+TEST_CASE("Equal runtime strings are one object", "[heap][vm]") {
+  VM vm;
+  REQUIRE(vm.interpret("string x = \"x\"\n"
+                       "string a = x + \"y\"\n"
+                       "string b = x + \"y\"\n") ==
+          InterpretResult::INTERPRET_OK);
+  REQUIRE(asObject(*vm.getGlobal("a")) == asObject(*vm.getGlobal("b")));
+  REQUIRE(vm.getHeap().stringCount() == 1);
+}
@@ -0,0 +1,107 @@
+#include <catch2/catch_all.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "bytecode.hpp"
+#include "parser.hpp"
+#include "vm.hpp"
+
+static std::vector<OpCode> opCodes(Bytecode& bytecode) {
+  std::vector<OpCode> result;
+  for (std::size_t offset = 0; offset < bytecode.count();) {
+    OpCode opCode = bytecode.getOpCode(offset);
+    result.push_back(opCode);
+    offset += instructionLength(opCode);
+  }
+  return result;
+}
+
+TEST_CASE("Peephole optimizer fuses instruction sequences", "[optimizer]") {
+  Parser parser;
+  std::shared_ptr<Bytecode> bytecode = std::make_shared<Bytecode>();
+
+  SECTION("Constant operands fuse into the arithmetic opcode") {
+    REQUIRE(parser.parse("let x = 1\nx * 3", bytecode) == true);
+
+    REQUIRE(opCodes(*bytecode) ==
+            std::vector<OpCode>{OpCode::CONSTANT, OpCode::DEFINE_GLOBAL,
+                                OpCode::GET_GLOBAL, OpCode::MULTIPLY_CONSTANT,
+                                OpCode::POP, OpCode::RETURN});
+  }
+
+  SECTION("Two global loads fuse into the arithmetic opcode") {
+    REQUIRE(parser.parse("let x = 1\nlet y = 2\nx - y", bytecode) == true);
+
+    std::vector<OpCode> code = opCodes(*bytecode);
+    REQUIRE(code[4] == OpCode::SUBTRACT_GLOBALS);
+    REQUIRE(code[5] == OpCode::POP);
+  }
+
+  SECTION("Assignment statements fuse with their POP") {
+    REQUIRE(parser.parse("int x = 1\nx = 2", bytecode) == true);
+
+    std::vector<OpCode> code = opCodes(*bytecode);
+    REQUIRE(code[3] == OpCode::SET_GLOBAL_POP);
+    REQUIRE(code[4] == OpCode::RETURN);
+  }
+
+  SECTION("Negated equality becomes the opposite comparison") {
+    REQUIRE(parser.parse("int x = 1\nint y = 2\nbool z = !(x == (y + 1))",
+                         bytecode) == true);
+
+    std::vector<OpCode> code = opCodes(*bytecode);
+    REQUIRE(std::find(code.begin(), code.end(), OpCode::NOT) == code.end());
+    REQUIRE(std::find(code.begin(), code.end(), OpCode::NOT_EQUAL) !=
+            code.end());
+  }
+
+  SECTION("Discarded literals are removed") {
+    REQUIRE(parser.parse("1 + 2\ntrue", bytecode) == true);
+
+    REQUIRE(opCodes(*bytecode) == std::vector<OpCode>{OpCode::RETURN});
+  }
+
+  SECTION("Fused instructions keep the line of the code they replace") {
+    REQUIRE(parser.parse("int x = 1\n\nx = x + 1", bytecode) == true);
+
+    for (std::size_t offset = 4; offset < bytecode->count() - 1; offset++) {
+      REQUIRE(bytecode->getLine(offset) == 3);
+    }
+  }
+
+  SECTION("The optimizer can be disabled") {
+    parser.setOptimize(false);
+    REQUIRE(parser.parse("1 + 2", bytecode) == true);
+
+    REQUIRE(opCodes(*bytecode) ==
+            std::vector<OpCode>{OpCode::CONSTANT, OpCode::POP,
+                                OpCode::RETURN});
+  }
+}
+
+TEST_CASE("Optimized and unoptimized code agree", "[optimizer]") {
+  VM optimized;
+  VM plain;
+  plain.setOptimize(false);
+
+  std::string source =
+      "int a = 7\nint b = 2\ndouble c = 1.5\n"
+      "int sum = a + b\nint quotient = a / b\ndouble scaled = c * 4\n"
+      "int difference = a - 3\nbool unequal = !(a == b)\n"
+      "bool equal = !(a != 7)\n"
+      "a = a + 1\nb = b * b\n";
+
+  REQUIRE(optimized.interpret(source) == InterpretResult::INTERPRET_OK);
+  REQUIRE(plain.interpret(source) == InterpretResult::INTERPRET_OK);
+
+  for (const char* name : {"a", "b", "sum", "quotient", "scaled", "difference",
+                           "unequal", "equal"}) {
+    REQUIRE(*optimized.getGlobal(name) == *plain.getGlobal(name));
+  }
+
+  SECTION("Fused instructions still report runtime errors") {
+    REQUIRE(optimized.interpret("int zero = 0\nint one = 1\none / zero") ==
+            InterpretResult::INTERPRET_RUNTIME_ERROR);
+    REQUIRE(optimized.interpret("one + missing") ==
+            InterpretResult::INTERPRET_RUNTIME_ERROR);
+  }
+}
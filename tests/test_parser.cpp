@@ -1,7 +1,11 @@
 #include <catch2/catch_all.hpp>
 #include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "bytecode.hpp"
+#include "interned_strings.hpp"
 #include "parser.hpp"
 
 TEST_CASE("Valid expressions are parsed correctly", "[parser]") {
@@ -33,6 +37,11 @@ TEST_CASE("Invalid expressions cause parsing errors", "[parser]") {
     std::string source = "1 + + 2";
     REQUIRE(parser.parse(source, bytecode) == false);
   }
+
+  SECTION("Logical operators without an infix rule") {
+    REQUIRE(parser.parse("true or false", bytecode) == false);
+    REQUIRE(parser.parse("let a = true; let b = a and a;", bytecode) == false);
+  }
 }
 
 TEST_CASE("Numeric literals are parsed correctly", "[parser]") {
@@ -109,4 +118,202 @@ TEST_CASE("Combined arithmetic and comparison expressions are parsed correctly",
     std::string source = "1 + 2 > 3 - 4";
     REQUIRE(parser.parse(source, bytecode) == true);
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Statements are separated by newlines or semicolons", "[parser]") {
+  Parser parser;
+  std::shared_ptr<Bytecode> bytecode = std::make_shared<Bytecode>();
+
+  SECTION("Newline separated expressions") {
+    std::string source = "1 + 2\n3 * 4\n";
+    REQUIRE(parser.parse(source, bytecode) == true);
+  }
+
+  SECTION("Semicolon separated declarations") {
+    std::string source = "int a = 1; double b = 2.0; a";
+    REQUIRE(parser.parse(source, bytecode) == true);
+  }
+
+  SECTION("Missing separator") {
+    std::string source = "1 + 2 3";
+    REQUIRE(parser.parse(source, bytecode) == false);
+  }
+}
+
+TEST_CASE("Assignments are parsed correctly", "[parser]") {
+  Parser parser;
+  std::shared_ptr<Bytecode> bytecode = std::make_shared<Bytecode>();
+
+  SECTION("Assignment to a variable") {
+    std::string source = "int x = 1\nx = x + 1";
+    REQUIRE(parser.parse(source, bytecode) == true);
+  }
+
+  SECTION("Assignment to an expression") {
+    std::string source = "int x = 1\nx + 1 = 2";
+    REQUIRE(parser.parse(source, bytecode) == false);
+  }
+}
+
+TEST_CASE("Constant expressions are folded at compile time", "[parser]") {
+  Parser parser;
+  parser.setOptimize(false);
+  std::shared_ptr<Bytecode> bytecode = std::make_shared<Bytecode>();
+
+  SECTION("Integer arithmetic folds into one constant") {
+    REQUIRE(parser.parse("60 * 60 * 24", bytecode) == true);
+
+    REQUIRE(bytecode->getOpCode(0) == OpCode::CONSTANT);
+    REQUIRE(asInt(bytecode->getConstant(bytecode->getConstantAddress(1))) ==
+            86400);
+    REQUIRE(bytecode->getOpCode(2) == OpCode::POP);
+    REQUIRE(bytecode->getOpCode(3) == OpCode::RETURN);
+  }
+
+  SECTION("Mixed int and double operands are promoted") {
+    REQUIRE(parser.parse("1 + 2.5", bytecode) == true);
+
+    Type folded = bytecode->getConstant(bytecode->getConstantAddress(1));
+    REQUIRE(isDouble(folded));
+    REQUIRE(asDouble(folded) == 3.5);
+  }
+
+  SECTION("Precedence and grouping are respected") {
+    REQUIRE(parser.parse("(1 + 2) * -3 - 4 / 2", bytecode) == true);
+
+    REQUIRE(asInt(bytecode->getConstant(bytecode->getConstantAddress(1))) ==
+            -11);
+  }
+
+  SECTION("Comparisons and negation fold into boolean opcodes") {
+    REQUIRE(parser.parse("!(1 < 2)", bytecode) == true);
+
+    REQUIRE(bytecode->getOpCode(0) == OpCode::FALSE);
+    REQUIRE(bytecode->getOpCode(1) == OpCode::POP);
+  }
+
+  SECTION("String literals are concatenated") {
+    REQUIRE(parser.parse("\"con\" + \"cat\"", bytecode) == true);
+
+    Type folded = bytecode->getConstant(bytecode->getConstantAddress(1));
+    REQUIRE(asString(folded) == getOrIntern("concat"));
+  }
+
+  SECTION("Only the constant part of an expression is folded") {
+    REQUIRE(parser.parse("let x = 1\nx + 2 * 3", bytecode) == true);
+
+    REQUIRE(bytecode->getOpCode(4) == OpCode::GET_GLOBAL);
+    REQUIRE(bytecode->getOpCode(6) == OpCode::CONSTANT);
+    REQUIRE(asInt(bytecode->getConstant(bytecode->getConstantAddress(7))) ==
+            6);
+    REQUIRE(bytecode->getOpCode(8) == OpCode::ADD);
+  }
+
+  SECTION("Type errors are reported at compile time") {
+    REQUIRE(parser.parse("true + 1", bytecode) == false);
+    REQUIRE(parser.parse("-false", bytecode) == false);
+    REQUIRE(parser.parse("!1", bytecode) == false);
+  }
+
+  SECTION("Integer overflow wraps around") {
+    auto folded = [&parser](const char* source) {
+      auto chunk = std::make_shared<Bytecode>();
+      REQUIRE(parser.parse(source, chunk) == true);
+      return asInt(chunk->getConstant(chunk->getConstantAddress(1)));
+    };
+
+    REQUIRE(folded("2147483647 + 1") == INT32_MIN);
+    REQUIRE(folded("-2147483647 - 2") == INT32_MAX);
+    REQUIRE(folded("65536 * 65536") == 0);
+    REQUIRE(folded("(-2147483647 - 1) / -1") == INT32_MIN);
+    REQUIRE(folded("-(-2147483647 - 1)") == INT32_MIN);
+  }
+
+  SECTION("Integer division by zero is reported at compile time") {
+    REQUIRE(parser.parse("1 / 0", bytecode) == false);
+  }
+}
+TEST_CASE("Declared types select specialized opcodes", "[parser]") {
+  Parser parser;
+  std::shared_ptr<Bytecode> bytecode = std::make_shared<Bytecode>();
+
+  SECTION("Typed int operands use the int opcodes") {
+    REQUIRE(parser.parse("int a = 1\nint b = 2\na + b < b * a", bytecode));
+
+    REQUIRE(bytecode->getOpCode(12) == OpCode::ADD_INT);
+    REQUIRE(bytecode->getOpCode(17) == OpCode::MULTIPLY_INT);
+    REQUIRE(bytecode->getOpCode(18) == OpCode::LESS_INT);
+  }
+
+  SECTION("Typed double and string operands") {
+    REQUIRE(parser.parse("double d = 1.5\nstring s = \"s\"\n-d / d\ns + s",
+                         bytecode));
+
+    REQUIRE(bytecode->getOpCode(10) == OpCode::NEGATE_DOUBLE);
+    REQUIRE(bytecode->getOpCode(13) == OpCode::DIVIDE_DOUBLE);
+    REQUIRE(bytecode->getOpCode(19) == OpCode::CONCAT_STR);
+  }
+
+  SECTION("Untyped operands keep the generic opcodes") {
+    parser.setOptimize(false);
+    REQUIRE(parser.parse("let a = 1\nint b = 2\na + b", bytecode));
+
+    REQUIRE(bytecode->getOpCode(12) == OpCode::ADD);
+  }
+
+  SECTION("Ints widen into double variables at compile time") {
+    REQUIRE(parser.parse("double d = 2", bytecode));
+
+    REQUIRE(isDouble(bytecode->getConstant(bytecode->getConstantAddress(1))));
+  }
+
+  SECTION("Stores of unknown type are checked at runtime") {
+    REQUIRE(parser.parse("let a = 1\nint b = a", bytecode));
+
+    REQUIRE(bytecode->getOpCode(6) == OpCode::COERCE);
+  }
+
+  SECTION("Provable type mismatches are compile errors") {
+    REQUIRE_FALSE(parser.parse("int i = 1.5", bytecode));
+    REQUIRE_FALSE(parser.parse("bool b = true\nb = \"no\"", bytecode));
+    REQUIRE_FALSE(parser.parse("string s = \"a\"\nint s = 1", bytecode));
+  }
+
+  SECTION("Declarations of a failed chunk are forgotten") {
+    REQUIRE_FALSE(parser.parse("int x = 1\n)", bytecode));
+    REQUIRE(parser.parse("string x = \"x\"", bytecode));
+  }
+}
+
+TEST_CASE("Several threads can compile at once", "[parser]") {
+  constexpr int THREADS = 4;
+  std::string source;
+  for (int i = 0; i < 500; i++) {
+    std::string n = std::to_string(i);
+    source += "let threaded" + n + " = \"text" + n + "\"\n";
+  }
+
+  std::vector<std::shared_ptr<Bytecode>> chunks(THREADS);
+  std::vector<char> parsed(THREADS);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < THREADS; t++) {
+    threads.emplace_back([&, t] {
+      Parser parser;
+      chunks[t] = std::make_shared<Bytecode>();
+      parsed[t] = parser.parse(source, chunks[t]);
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  // Every thread interned the same strings.
+  for (int t = 0; t < THREADS; t++) {
+    REQUIRE(parsed[t]);
+    REQUIRE(chunks[t]->constantCount() == chunks[0]->constantCount());
+    for (std::size_t i = 0; i < chunks[0]->constantCount(); i++) {
+      REQUIRE(chunks[t]->getConstant(i) == chunks[0]->getConstant(i));
+    }
+  }
+  REQUIRE(asString(chunks[0]->getConstant(0)) == getOrIntern("text0"));
+}
@@ -3,6 +3,7 @@
 #include <iostream>
 
 #include "allocator.hpp"
+#include "char_scan.hpp"
 #include "dynamic_types.hpp"
 #include "tokenizer.hpp"
 
@@ -13,28 +14,22 @@ void skipTokens(Tokenizer& tokenizer, int count) {
 }
 
 bool compareTypes(const Type& lhs, const Type& rhs) {
-  return std::visit(
-      [](auto&& left, auto&& right) -> bool {
-        using L = std::decay_t<decltype(left)>;
-        using R = std::decay_t<decltype(right)>;
-
-        if constexpr (std::is_same_v<L, R>) {
-          if constexpr (std::is_same_v<L, Object*>) {
-            if (!left || !right) return left == right;
-            return *left == *right;
-          } else {
-            return left == right;
-          }
-        }
-        return false;
-      },
-      lhs, rhs);
+  if (!isSameType(lhs, rhs)) {
+    return false;
+  }
+
+  if (isObject(lhs)) {
+    Object* left = asObject(lhs);
+    Object* right = asObject(rhs);
+    if (!left || !right) return left == right;
+    return *left == *right;
+  }
+  return lhs == rhs;
 }
 
 std::vector<Token> tokens = {
     {1, TokenType::STRING, "\"Hello, World!\"",
-     std::make_optional<Type>(
-         allocateAndConstruct<ObjString>("Hello, World!"))},
+     std::make_optional<Type>(ObjString::create("Hello, World!"))},
     {2, TokenType::INTEGER, "123", std::make_optional<Type>(123)},
     {3, TokenType::DOUBLE, "3.1415", std::make_optional<Type>(3.1415)},
     {4, TokenType::NUL, "nil"},
@@ -484,3 +479,176 @@ TEST_CASE("Tokenizer auto inserts semicolons:", "[tokenizer]") {
     REQUIRE(rightBrace.lexeme == "}");
   }
 }
+
+static std::string scanAll(std::string_view source) {
+  Tokenizer tokenizer(source);
+  std::string actualTokens;
+  for (TokenType type = tokenizer.scanToken().type; type != TokenType::TEOF;
+       type = tokenizer.scanToken().type) {
+    actualTokens += tokenTypeToString(type) + " ";
+  }
+  if (!actualTokens.empty()) {
+    actualTokens.pop_back();
+  }
+  return actualTokens;
+}
+
+TEST_CASE("Comments are skipped", "[tokenizer]") {
+  REQUIRE(scanAll("// comment\n1\n") == "INTEGER ;");
+  REQUIRE(scanAll("1 // comment\n2") == "INTEGER ; INTEGER");
+  REQUIRE(scanAll("1 /* inline */ + 2") == "INTEGER + INTEGER");
+  REQUIRE(scanAll("/* unterminated") == "");
+  REQUIRE(scanAll("a / b") == "IDENT / IDENT");
+
+  Tokenizer sut("/* one\ntwo\n*/ x\n\n\n   // three\ny");
+  REQUIRE(sut.scanToken().line == 3);
+  REQUIRE(sut.scanToken().type == TokenType::SEMICOLON);
+  REQUIRE(sut.scanToken().line == 7);
+}
+
+TEST_CASE("Long runs cross scanning blocks", "[tokenizer]") {
+  std::string name(100, 'a');
+  name += "_Z9";
+  std::string body = "line one\n" + std::string(70, 'x') + "\nline three";
+  std::string source = std::string(40, ' ') + std::string(37, '\n') +
+                       std::string(33, '\t') + name + " \"" + body + "\"\n" +
+                       "after";
+
+  Tokenizer sut(source);
+  Token identifier = sut.scanToken();
+  REQUIRE(identifier.type == TokenType::IDENTIFIER);
+  REQUIRE(identifier.lexeme == name);
+  REQUIRE(identifier.line == 38);
+
+  Token string = sut.scanToken();
+  REQUIRE(string.type == TokenType::STRING);
+  REQUIRE(asString(*string.literal)->toString() == body);
+  REQUIRE(string.line == 40);
+
+  REQUIRE(sut.scanToken().type == TokenType::SEMICOLON);
+  REQUIRE(sut.scanToken().line == 41);
+}
+
+TEST_CASE("Block scanning matches a character scan", "[tokenizer]") {
+  const std::string alphabet = "  \t\r\n\nab_Z09\"*/-\x80\xff";
+  uint32_t state = 12345;
+  auto random = [&]() {
+    state = state * 1103515245 + 12345;
+    return state >> 16;
+  };
+
+  for (int round = 0; round < 2000; round++) {
+    std::size_t size = random() % 100;
+    std::string text;
+    // Long runs of one class so whole blocks are skipped.
+    while (text.size() < size) {
+      char ch = alphabet[random() % alphabet.size()];
+      text.append(random() % 40 + 1, ch);
+    }
+    text.resize(size);
+    std::size_t pos = size ? random() % size : 0;
+    const char* s = text.data();
+
+    std::size_t expected = pos;
+    while (expected < size && isBlankChar(s[expected])) expected++;
+    REQUIRE(scanBlanks(s, pos, size) == expected);
+
+    expected = pos;
+    while (expected < size && isIdentifierChar(s[expected])) expected++;
+    REQUIRE(scanIdentifier(s, pos, size) == expected);
+
+    std::size_t expectedLines = 0;
+    expected = pos;
+    for (; expected < size && (isBlankChar(s[expected]) || s[expected] == '\n');
+         expected++) {
+      expectedLines += s[expected] == '\n';
+    }
+    std::size_t newlines = 0;
+    REQUIRE(scanWhitespace(s, pos, size, newlines) == expected);
+    REQUIRE(newlines == expectedLines);
+
+    expectedLines = 0;
+    expected = pos;
+    for (; expected < size && s[expected] != '"'; expected++) {
+      expectedLines += s[expected] == '\n';
+    }
+    newlines = 0;
+    REQUIRE(scanUntil(s, pos, size, '"', newlines) == expected);
+    REQUIRE(newlines == expectedLines);
+  }
+}
+
+TEST_CASE("All keywords are recognized", "[tokenizer]") {
+  const std::vector<std::pair<std::string, TokenType>> keywords = {
+      {"and", TokenType::AND},
+      {"bool", TokenType::LET_BOOL},
+      {"double", TokenType::LET_DOUBLE},
+      {"else", TokenType::ELSE},
+      {"false", TokenType::FALSE},
+      {"for", TokenType::FOR},
+      {"fn", TokenType::FN},
+      {"in", TokenType::IN},
+      {"int", TokenType::LET_INTEGER},
+      {"interface", TokenType::INTERFACE},
+      {"if", TokenType::IF},
+      {"let", TokenType::LET},
+      {"mut", TokenType::MUT},
+      {"nil", TokenType::NUL},
+      {"or", TokenType::OR},
+      {"return", TokenType::RETURN},
+      {"returnif", TokenType::RETURNIF},
+      {"string", TokenType::LET_STRING},
+      {"struct", TokenType::STRUCT},
+      {"this", TokenType::THIS},
+      {"true", TokenType::TRUE},
+  };
+  REQUIRE(keywords.size() == 21);
+
+  for (const auto& [keyword, type] : keywords) {
+    INFO(keyword);
+    Token token = Token::lookup(keyword, 1);
+    REQUIRE(token.type == type);
+    REQUIRE(token.lexeme == keyword);
+
+    // Words sharing the keyword's first and last characters or length
+    // must not be mistaken for it.
+    REQUIRE(Token::lookup(keyword + "s", 1).type == TokenType::IDENTIFIER);
+    REQUIRE(Token::lookup("_" + keyword, 1).type == TokenType::IDENTIFIER);
+    std::string changed = keyword;
+    changed[changed.size() / 2] = 'X';
+    REQUIRE(Token::lookup(changed, 1).type == TokenType::IDENTIFIER);
+  }
+
+  REQUIRE(Token::lookup("x", 1).type == TokenType::IDENTIFIER);
+  REQUIRE(Token::lookup("interfaces", 1).type == TokenType::IDENTIFIER);
+  REQUIRE(Token::lookup("True", 1).type == TokenType::IDENTIFIER);
+  REQUIRE(*Token::lookup("true", 1).literal == Type(true));
+}
+
+TEST_CASE("Tokens are packed into a reusable buffer", "[tokenizer]") {
+  TokenBuffer buffer;
+  std::string source = "let x = 1.5\n\"s\" + 99999999999 @";
+  Tokenizer(source).scanAll(buffer);
+
+  REQUIRE(buffer.size() == 10);
+  REQUIRE(buffer[0].type == TokenType::LET);
+  REQUIRE(buffer.lexeme(1) == "x");
+  REQUIRE(buffer[3].type == TokenType::DOUBLE);
+  REQUIRE(asDouble(buffer.literal(3)) == 1.5);
+  REQUIRE(buffer[4].type == TokenType::SEMICOLON);
+  REQUIRE(buffer[4].line == 1);
+  REQUIRE(buffer[5].line == 2);
+  REQUIRE(asString(buffer.literal(5))->toString() == "s");
+
+  // Scan errors do not stop the scan; their messages are kept aside.
+  REQUIRE(buffer[7].type == TokenType::ERROR);
+  REQUIRE(buffer.error(7).find("out of range") != std::string::npos);
+  REQUIRE(buffer[8].type == TokenType::ERROR);
+  REQUIRE(buffer.error(8) == "Unexpected character.");
+  REQUIRE(buffer[9].type == TokenType::TEOF);
+
+  Tokenizer("a").scanAll(buffer);
+  REQUIRE(buffer.size() == 2);
+  REQUIRE(buffer.lexeme(0) == "a");
+  REQUIRE(buffer[1].type == TokenType::TEOF);
+}
@@ -0,0 +1,187 @@
+#include <catch2/catch_all.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "allocator.hpp"
+#include "interned_strings.hpp"
+#include "types.hpp"
+
+TEST_CASE("Values are NaN-boxed into 8 bytes", "[types]") {
+  REQUIRE(sizeof(Type) == 8);
+}
+
+TEST_CASE("Values round trip through the boxed representation", "[types]") {
+  SECTION("null") {
+    Type value = Null{};
+
+    REQUIRE(isNull(value));
+    REQUIRE_FALSE(isBool(value));
+    REQUIRE_FALSE(isInt(value));
+    REQUIRE_FALSE(isDouble(value));
+    REQUIRE_FALSE(isObject(value));
+    REQUIRE(isNull(Type()));
+  }
+
+  SECTION("booleans") {
+    Type t = true;
+    Type f = false;
+
+    REQUIRE(isBool(t));
+    REQUIRE(isBool(f));
+    REQUIRE(asBool(t));
+    REQUIRE_FALSE(asBool(f));
+    REQUIRE_FALSE(isNull(f));
+  }
+
+  SECTION("integers") {
+    for (int32_t number : {0, 1, -1, 42, std::numeric_limits<int32_t>::max(),
+                           std::numeric_limits<int32_t>::min()}) {
+      Type value = number;
+
+      REQUIRE(isInt(value));
+      REQUIRE_FALSE(isDouble(value));
+      REQUIRE_FALSE(isObject(value));
+      REQUIRE(asInt(value) == number);
+    }
+  }
+
+  SECTION("doubles") {
+    for (double number : {0.0, -0.0, 3.1415, -1e300,
+                          std::numeric_limits<double>::infinity()}) {
+      Type value = number;
+
+      REQUIRE(isDouble(value));
+      REQUIRE_FALSE(isInt(value));
+      REQUIRE(asDouble(value) == number);
+    }
+  }
+
+  SECTION("NaN stays a double") {
+    Type value = -std::numeric_limits<double>::quiet_NaN();
+
+    REQUIRE(isDouble(value));
+    REQUIRE(std::isnan(asDouble(value)));
+    REQUIRE_FALSE(value == value);
+  }
+
+  SECTION("objects") {
+    ObjString* str = ObjString::create("boxed");
+    Type value = str;
+
+    REQUIRE(isObject(value));
+    REQUIRE(isString(value));
+    REQUIRE_FALSE(isDouble(value));
+    REQUIRE(asObject(value) == str);
+    REQUIRE(asString(value) == str);
+
+    ObjString::destroy(str);
+  }
+}
+
+TEST_CASE("Values compare like the previous variant did", "[types]") {
+  REQUIRE(Type(1) == Type(1));
+  REQUIRE_FALSE(Type(1) == Type(1.0));
+  REQUIRE(Type(0.0) == Type(-0.0));
+  REQUIRE_FALSE(Type(true) == Type(1));
+  REQUIRE(Type(Null{}) == Type());
+  REQUIRE(isSameType(Type(1), Type(2)));
+  REQUIRE_FALSE(isSameType(Type(1), Type(2.0)));
+}
+
+TEST_CASE("Strings keep their characters inline", "[types]") {
+  std::string_view chars("a\0b", 3);
+  ObjString* str = ObjString::create(chars);
+
+  REQUIRE(str->length() == 3);
+  REQUIRE(str->view() == chars);
+  REQUIRE(str->toChar() == reinterpret_cast<const char*>(str + 1));
+  REQUIRE(str->toChar()[3] == '\0');
+  REQUIRE(str->hash() == ObjString::hashOf(chars));
+
+  ObjString::destroy(str);
+}
+
+TEST_CASE("The string table interns each string once", "[types]") {
+  ConcurrentStringTable table;
+  std::vector<ObjString*> strings;
+  for (int i = 0; i < 1000; i++) {
+    strings.push_back(table.intern("name" + std::to_string(i)));
+  }
+  REQUIRE(table.size() == 1000);
+
+  // Lookups after the table has grown still find the first copies.
+  for (int i = 0; i < 1000; i++) {
+    std::string name = "name" + std::to_string(i);
+    REQUIRE(table.intern(name) == strings[i]);
+    REQUIRE(table.find(name, ObjString::hashOf(name)) == strings[i]);
+  }
+  REQUIRE(table.size() == 1000);
+  REQUIRE(table.find("missing", ObjString::hashOf("missing")) == nullptr);
+  REQUIRE(table.intern("") != nullptr);
+
+  table.clear();
+  REQUIRE(table.size() == 0);
+  REQUIRE(table.find("name0", ObjString::hashOf("name0")) == nullptr);
+}
+
+TEST_CASE("Removing from a weak table keeps other strings findable",
+          "[types]") {
+  WeakStringTable table;
+  std::vector<ObjString*> strings;
+  for (int i = 0; i < 1000; i++) {
+    strings.push_back(ObjString::create("name" + std::to_string(i)));
+    table.add(strings.back());
+  }
+
+  for (int i = 0; i < 1000; i += 3) {
+    table.remove(strings[i]);
+  }
+  REQUIRE(table.size() == 666);
+  for (int i = 0; i < 1000; i++) {
+    ObjString* string = strings[i];
+    ObjString* found = table.find(string->view(), string->hash());
+    REQUIRE(found == (i % 3 == 0 ? nullptr : string));
+  }
+
+  for (ObjString* string : strings) {
+    ObjString::destroy(string);
+  }
+}
+
+TEST_CASE("Threads interning the same strings share them", "[types]") {
+  constexpr int THREADS = 4;
+  constexpr int NAMES = 2000;
+  ConcurrentStringTable table;
+  std::vector<std::vector<ObjString*>> interned(THREADS);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < THREADS; t++) {
+    threads.emplace_back([&, t] {
+      // Threads walk the names in different orders so they race on both
+      // inserts and resizes.
+      for (int i = 0; i < NAMES; i++) {
+        int name = t % 2 ? NAMES - 1 - i : i;
+        interned[t].push_back(table.intern("shared" + std::to_string(name)));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  REQUIRE(table.size() == NAMES);
+  for (int t = 1; t < THREADS; t++) {
+    for (int i = 0; i < NAMES; i++) {
+      int name = t % 2 ? NAMES - 1 - i : i;
+      REQUIRE(interned[t][i] == interned[0][name]);
+    }
+  }
+  REQUIRE(interned[0][7]->view() == "shared7");
+
+  table.clear();
+  REQUIRE(table.size() == 0);
+}
@@ -1,9 +1,328 @@
 #include <catch2/catch_all.hpp>
 #include <catch2/catch_test_macros.hpp>
+#include <cmath>
 
 #include "vm.hpp"
 
-TEST_CASE("VM instruction interpretation", "[bytecode]") {
-  SECTION("OP_CONSTANT is ") {
+static std::string nestedAddition(int depth) {
+  std::string source = "int one = 1\n";
+  for (int i = 0; i < depth; i++) {
+    source += "one + (";
   }
+  source += "one";
+  source += std::string(depth, ')');
+  return source;
 }
+
+TEST_CASE("VM instruction interpretation", "[vm]") {
+  VM vm;
+
+  SECTION("Arithmetic expression statements run to completion") {
+    REQUIRE(vm.interpret("1 + 2\n3 * 4.5\n") ==
+            InterpretResult::INTERPRET_OK);
+  }
+
+  SECTION("Type errors are reported as runtime errors") {
+    REQUIRE(vm.interpret("bool yes = true\n-yes") ==
+            InterpretResult::INTERPRET_RUNTIME_ERROR);
+  }
+
+  SECTION("The VM can be reused after a runtime error") {
+    REQUIRE(vm.interpret("int one = 1\n!one") ==
+            InterpretResult::INTERPRET_RUNTIME_ERROR);
+    REQUIRE(vm.interpret("!false") == InterpretResult::INTERPRET_OK);
+  }
+}
+
+TEST_CASE("VM operand stack", "[vm]") {
+  VM vm;
+
+  SECTION("Many statements do not accumulate stack slots") {
+    std::string source;
+    for (int i = 0; i < 1000; i++) {
+      source += "1 + 2\n";
+    }
+
+    REQUIRE(vm.interpret(source) == InterpretResult::INTERPRET_OK);
+  }
+
+  SECTION("Expressions within the stack limit run") {
+    REQUIRE(vm.interpret(nestedAddition(200)) ==
+            InterpretResult::INTERPRET_OK);
+  }
+
+  SECTION("Expressions deeper than the stack limit overflow") {
+    REQUIRE(vm.interpret(nestedAddition(300)) ==
+            InterpretResult::INTERPRET_RUNTIME_ERROR);
+  }
+}
+
+TEST_CASE("VM global variables", "[vm]") {
+  VM vm;
+
+  SECTION("Defined globals can be read back") {
+    REQUIRE(vm.interpret("int answer = 40 + 2") ==
+            InterpretResult::INTERPRET_OK);
+
+    auto answer = vm.getGlobal("answer");
+    REQUIRE(answer.has_value());
+    REQUIRE(asInt(*answer) == 42);
+  }
+
+  SECTION("Declarations without an initializer get the type's default") {
+    REQUIRE(vm.interpret("int i\ndouble d\nbool b") ==
+            InterpretResult::INTERPRET_OK);
+
+    REQUIRE(asInt(*vm.getGlobal("i")) == 0);
+    REQUIRE(asDouble(*vm.getGlobal("d")) == 0.0);
+    REQUIRE(asBool(*vm.getGlobal("b")) == false);
+  }
+
+  SECTION("Assignment updates an existing global") {
+    REQUIRE(vm.interpret("int counter = 1\ncounter = counter + 1\n"
+                         "counter = counter * 10") ==
+            InterpretResult::INTERPRET_OK);
+
+    REQUIRE(asInt(*vm.getGlobal("counter")) == 20);
+  }
+
+  SECTION("Globals survive across interpret calls") {
+    REQUIRE(vm.interpret("int a = 1") == InterpretResult::INTERPRET_OK);
+    REQUIRE(vm.interpret("int b = a + 1") == InterpretResult::INTERPRET_OK);
+
+    REQUIRE(asInt(*vm.getGlobal("b")) == 2);
+  }
+
+  SECTION("Reading an undefined variable is a runtime error") {
+    REQUIRE(vm.interpret("missing + 1") ==
+            InterpretResult::INTERPRET_RUNTIME_ERROR);
+    REQUIRE_FALSE(vm.getGlobal("missing").has_value());
+  }
+
+  SECTION("Assigning an undefined variable is a runtime error") {
+    REQUIRE(vm.interpret("missing = 1") ==
+            InterpretResult::INTERPRET_RUNTIME_ERROR);
+  }
+
+  SECTION("Globals past the short slot range use the long encoding") {
+    std::string source;
+    for (int i = 0; i < 300; i++) {
+      source += "int g" + std::to_string(i) + " = " + std::to_string(i) + "\n";
+    }
+    source += "g299 = g299 + g1\n";
+
+    REQUIRE(vm.interpret(source) == InterpretResult::INTERPRET_OK);
+    REQUIRE(asInt(*vm.getGlobal("g299")) == 300);
+  }
+}
+
+TEST_CASE("VM and constant folding agree", "[vm]") {
+  VM vm;
+
+  SECTION("Folded and runtime arithmetic give the same values") {
+    REQUIRE(vm.interpret("int a = 7\ndouble folded = 7 / 2 + 1.5\n"
+                         "double runtime = a / 2 + 1.5") ==
+            InterpretResult::INTERPRET_OK);
+
+    REQUIRE(*vm.getGlobal("folded") == *vm.getGlobal("runtime"));
+  }
+
+  SECTION("Folded strings are interned like runtime concatenations") {
+    REQUIRE(vm.interpret("string a = \"a\"\n"
+                         "bool same = a + \"b\" == \"a\" + \"b\"") ==
+            InterpretResult::INTERPRET_OK);
+
+    REQUIRE(asBool(*vm.getGlobal("same")));
+  }
+
+  SECTION("Integer division by zero is a runtime error") {
+    REQUIRE(vm.interpret("int zero = 0\n1 / zero") ==
+            InterpretResult::INTERPRET_RUNTIME_ERROR);
+  }
+
+  SECTION("Integer overflow wraps around at runtime too") {
+    REQUIRE(vm.interpret("let max = 2147483647\nlet min = -max - 1\n"
+                         "let one = 1\nlet minusOne = -1\n"
+                         "bool sum = max + one == 2147483647 + 1\n"
+                         "bool quotient = min / minusOne == min\n"
+                         "bool negated = -min == min") ==
+            InterpretResult::INTERPRET_OK);
+
+    REQUIRE(asBool(*vm.getGlobal("sum")));
+    REQUIRE(asBool(*vm.getGlobal("quotient")));
+    REQUIRE(asBool(*vm.getGlobal("negated")));
+  }
+}
+
+TEST_CASE("VM typed globals", "[vm]") {
+  VM vm;
+
+  SECTION("Specialized arithmetic matches the generic opcodes") {
+    REQUIRE(vm.interpret("int a = 7\nint b = 2\ndouble c = 1.5\n"
+                         "let x = 7\nlet y = 2\nlet z = 1.5\n"
+                         "bool same = a / b - -a * b == x / y - -x * y\n"
+                         "bool sameDouble = c * c / c - c == z * z / z - z\n"
+                         "bool less = a < b == x < y\n") ==
+            InterpretResult::INTERPRET_OK);
+
+    REQUIRE(asBool(*vm.getGlobal("same")));
+    REQUIRE(asBool(*vm.getGlobal("sameDouble")));
+    REQUIRE(asBool(*vm.getGlobal("less")));
+  }
+
+  SECTION("Ints are widened when stored into double variables") {
+    REQUIRE(vm.interpret("let i = 3\ndouble d = i\nd = d + i") ==
+            InterpretResult::INTERPRET_OK);
+
+    REQUIRE(isDouble(*vm.getGlobal("d")));
+    REQUIRE(asDouble(*vm.getGlobal("d")) == 6.0);
+  }
+
+  SECTION("Stores of the wrong dynamic type are runtime errors") {
+    REQUIRE(vm.interpret("let s = \"s\"\nint i = s") ==
+            InterpretResult::INTERPRET_RUNTIME_ERROR);
+  }
+
+  SECTION("Specialized int arithmetic wraps around like the generic one") {
+    REQUIRE(vm.interpret("int max = 2147483647\nint min = -max - 1\n"
+                         "int minusOne = -1\nint sum = max + 1\n"
+                         "int product = max * max\n"
+                         "int quotient = min / minusOne\nint negated = -min") ==
+            InterpretResult::INTERPRET_OK);
+
+    REQUIRE(asInt(*vm.getGlobal("sum")) == INT32_MIN);
+    REQUIRE(asInt(*vm.getGlobal("product")) == 1);
+    REQUIRE(asInt(*vm.getGlobal("quotient")) == INT32_MIN);
+    REQUIRE(asInt(*vm.getGlobal("negated")) == INT32_MIN);
+  }
+
+  SECTION("Typed integer division by zero is a runtime error") {
+    REQUIRE(vm.interpret("int a = 1\nint b = 0\na / b") ==
+            InterpretResult::INTERPRET_RUNTIME_ERROR);
+  }
+}
+
+TEST_CASE("VM quickens generic opcodes", "[vm]") {
+  VM vm;
+  vm.setOptimize(false);
+  REQUIRE(vm.interpret("let a = 1\nlet b = 2") ==
+          InterpretResult::INTERPRET_OK);
+
+  std::shared_ptr<Bytecode> chunk = vm.compile("let c = a + b");
+  REQUIRE(chunk->getOpCode(0) == OpCode::GET_GLOBAL);
+  REQUIRE(chunk->getOpCode(4) == OpCode::ADD);
+
+  SECTION("Observed operand types select a quickened form") {
+    REQUIRE(vm.interpret(chunk) == InterpretResult::INTERPRET_OK);
+
+    REQUIRE(chunk->getOpCode(0) == OpCode::GET_GLOBAL_QUICK);
+    REQUIRE(chunk->getOpCode(2) == OpCode::GET_GLOBAL_QUICK);
+    REQUIRE(chunk->getOpCode(4) == OpCode::ADD_INT_QUICK);
+    REQUIRE(asInt(*vm.getGlobal("c")) == 3);
+  }
+
+  SECTION("A failed guard falls back to the generic opcode") {
+    REQUIRE(vm.interpret(chunk) == InterpretResult::INTERPRET_OK);
+    REQUIRE(vm.interpret("a = \"a\"") == InterpretResult::INTERPRET_OK);
+    REQUIRE(vm.interpret(chunk) == InterpretResult::INTERPRET_OK);
+
+    REQUIRE(chunk->getOpCode(4) == OpCode::ADD);
+    REQUIRE(asString(*vm.getGlobal("c"))->view() == "a2");
+
+    REQUIRE(vm.interpret("b = \"b\"") == InterpretResult::INTERPRET_OK);
+    REQUIRE(vm.interpret(chunk) == InterpretResult::INTERPRET_OK);
+    REQUIRE(chunk->getOpCode(4) == OpCode::CONCAT_STR_QUICK);
+    REQUIRE(asString(*vm.getGlobal("c"))->view() == "ab");
+  }
+
+  SECTION("Quickened division keeps the division by zero error") {
+    REQUIRE(vm.interpret("let zero = 0") == InterpretResult::INTERPRET_OK);
+    std::shared_ptr<Bytecode> divide = vm.compile("b / zero");
+    REQUIRE(vm.interpret("zero = 1") == InterpretResult::INTERPRET_OK);
+    REQUIRE(vm.interpret(divide) == InterpretResult::INTERPRET_OK);
+    REQUIRE(vm.interpret("zero = 0") == InterpretResult::INTERPRET_OK);
+
+    REQUIRE(vm.interpret(divide) ==
+            InterpretResult::INTERPRET_RUNTIME_ERROR);
+  }
+
+  SECTION("Quickened division by zero of a double dividend is infinite") {
+    REQUIRE(vm.interpret("let x = 4\nlet zero = 2") ==
+            InterpretResult::INTERPRET_OK);
+    std::shared_ptr<Bytecode> divide = vm.compile("let q = x / zero");
+    REQUIRE(vm.interpret(divide) == InterpretResult::INTERPRET_OK);
+    REQUIRE(divide->getOpCode(4) == OpCode::DIVIDE_INT_QUICK);
+    REQUIRE(vm.interpret("x = 1.5\nzero = 0") ==
+            InterpretResult::INTERPRET_OK);
+
+    REQUIRE(vm.interpret(divide) == InterpretResult::INTERPRET_OK);
+    REQUIRE(std::isinf(asDouble(*vm.getGlobal("q"))));
+  }
+
+  SECTION("Chunks only run on the VM that compiled them") {
+    VM other;
+    REQUIRE(other.interpret(chunk) ==
+            InterpretResult::INTERPRET_COMPILE_ERROR);
+  }
+}
+
+TEST_CASE("VM execution tracer", "[vm]") {
+  VM vm;
+  vm.setOptimize(false);
+  std::ostringstream trace;
+
+  SECTION("Instructions and the stack are traced") {
+    vm.setTracer(std::make_unique<Tracer>(Tracer::OPS | Tracer::STACK, trace));
+    REQUIRE(vm.interpret("let a = 1\na + 2") == InterpretResult::INTERPRET_OK);
+
+    REQUIRE(trace.str().find("GET_GLOBAL") != std::string::npos);
+    REQUIRE(trace.str().find("[ 1 ][ 2 ]") != std::string::npos);
+    REQUIRE(trace.str().find("== code ==") == std::string::npos);
+  }
+
+  SECTION("Flags select what is traced") {
+    vm.setTracer(std::make_unique<Tracer>(Tracer::CODE, trace));
+    REQUIRE(vm.interpret("1 + 2") == InterpretResult::INTERPRET_OK);
+
+    REQUIRE(trace.str().find("== code ==") != std::string::npos);
+    REQUIRE(trace.str().find("[ ") == std::string::npos);
+  }
+
+  SECTION("Tracing can be turned off again") {
+    vm.setTracer(std::make_unique<Tracer>(Tracer::ALL, trace));
+    vm.setTracer(nullptr);
+    REQUIRE(vm.interpret("1 + 2") == InterpretResult::INTERPRET_OK);
+
+    REQUIRE(trace.str().empty());
+  }
+
+  SECTION("Trace flags are parsed from a list") {
+    REQUIRE(Tracer::parseFlags("ops,stack") == (Tracer::OPS | Tracer::STACK));
+    REQUIRE(Tracer::parseFlags("code") == Tracer::CODE);
+    REQUIRE_FALSE(Tracer::parseFlags("ops,bogus").has_value());
+  }
+}
+
+#ifdef ONOL_PROFILER
+TEST_CASE("VM profiler", "[vm]") {
+  VM vm;
+  REQUIRE(vm.enableProfiling());
+  vm.setOptimize(false);
+
+  REQUIRE(vm.interpret("let a = 1\nlet b = 2\na + b\n\nb * a") ==
+          InterpretResult::INTERPRET_OK);
+  REQUIRE(vm.interpret("a + b") == InterpretResult::INTERPRET_OK);
+
+  const Profiler* profiler = vm.getProfiler();
+  REQUIRE(profiler->getCount(OpCode::GET_GLOBAL) == 6);
+  REQUIRE(profiler->getCount(OpCode::ADD) == 2);
+  REQUIRE(profiler->getCount(OpCode::MULTIPLY) == 1);
+  REQUIRE(profiler->getCount(OpCode::RETURN) == 2);
+  REQUIRE(profiler->getLineCount(3) == 4);
+  REQUIRE(profiler->getLineCount(5) == 5);
+
+  std::ostringstream report;
+  profiler->report(report);
+  REQUIRE(report.str().find("GET_GLOBAL") != std::string::npos);
+}
+#endif